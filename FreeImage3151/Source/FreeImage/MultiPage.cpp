@@ -302,8 +302,9 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, BOOL crea
 						// we can use release() as std::bad_alloc won't be thrown from here on
 						header->m_cachefile = cache_file.release();
 					} else {
-						// an error occured ...
-						fclose(handle);
+						// an error occured ... (a new file has no handle yet)
+						if (handle)
+							fclose(handle);
 						return NULL;
 					}
 				}
@@ -31,8 +31,12 @@
 #include "../OpenEXR/IlmImf/ImfRgba.h"
 #include "../OpenEXR/IlmImf/ImfArray.h"
 #include "../OpenEXR/IlmImf/ImfPreviewImage.h"
+#include "../OpenEXR/IlmImf/ImfThreading.h"
+#include "../OpenEXR/IlmThread/IlmThread.h"
 #include "../OpenEXR/Half/half.h"
 
+#include <thread>
+
 
 // ==========================================================
 // Plugin Interface
@@ -745,6 +749,12 @@ void DLL_CALLCONV
 InitEXR(Plugin *plugin, int format_id) {
 	s_format_id = format_id;
 
+	// compress / decompress scan line blocks on the IlmThread pool
+	if(IlmThread::supportsThreads() && (Imf::globalThreadCount() == 0)) {
+		int n_threads = (int)std::thread::hardware_concurrency();
+		Imf::setGlobalThreadCount(n_threads > 0 ? n_threads : 1);
+	}
+
 	plugin->format_proc = Format;
 	plugin->description_proc = Description;
 	plugin->extension_proc = Extension;
@@ -89,8 +89,8 @@ static BOOL rgbe_WriteHeader(FreeImageIO *io, fi_handle handle, unsigned width,
 static BOOL rgbe_ReadPixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels);
 static BOOL rgbe_WritePixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels);
 static BOOL rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanline_width, unsigned num_scanlines);
-static BOOL rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes);
-static BOOL rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines);
+static int rgbe_EncodeBytes_RLE(const BYTE *data, int numbytes, BYTE *out);
+static BOOL rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines, BYTE *channels, BYTE *encoded);
 static BOOL rgbe_ReadMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info);
 static BOOL rgbe_WriteMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info);
 
@@ -151,6 +151,19 @@ rgbe_FloatToRGBE(BYTE rgbe[4], FIRGBF *rgbf) {
 	if (v < 1e-32) {
 		rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
 	}
+	else if (v <= FLT_MAX) {
+		// frexp(v) * 256 / v is exactly 2^(8 - e): read e from the exponent 
+		// bits and build the scale the same way, without the libm call
+		union { float f; DWORD u; } bits;
+		bits.f = v;
+		e = (int)((bits.u >> 23) & 0xFF) - 126;
+		bits.u = (DWORD)(8 - e + 127) << 23;
+		v = bits.f;
+		rgbe[0] = (BYTE) (rgbf->red * v);
+		rgbe[1] = (BYTE) (rgbf->green * v);
+		rgbe[2] = (BYTE) (rgbf->blue * v);
+		rgbe[3] = (BYTE) (e + 128);
+	}
 	else {
 		v = (float)(frexp(v, &e) * 256.0 / v);
 		rgbe[0] = (BYTE) (rgbf->red * v);
@@ -442,13 +455,13 @@ rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanlin
  Run length encoding adds considerable complexity but does 
  save some space.  For each scanline, each channel (r,g,b,e) is 
  encoded separately for better compression. 
- @return Returns TRUE if successful, returns FALSE otherwise
+ @return Returns the number of bytes written to out
 */
-static BOOL 
-rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes) {
+static int 
+rgbe_EncodeBytes_RLE(const BYTE *data, int numbytes, BYTE *out) {
 	static const int MINRUNLENGTH = 4;
 	int cur, beg_run, run_count, old_run_count, nonrun_count;
-	BYTE buf[2];
+	BYTE *dst = out;
 	
 	cur = 0;
 	while(cur < numbytes) {
@@ -459,15 +472,13 @@ rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes)
 			beg_run += run_count;
 			old_run_count = run_count;
 			run_count = 1;
-			while((data[beg_run] == data[beg_run + run_count]) && (beg_run + run_count < numbytes) && (run_count < 127))
+			while((beg_run + run_count < numbytes) && (run_count < 127) && (data[beg_run] == data[beg_run + run_count]))
 				run_count++;
 		}
 		// if data before next big run is a short run then write it as such 
 		if ((old_run_count > 1)&&(old_run_count == beg_run - cur)) {
-			buf[0] = (BYTE)(128 + old_run_count);   // write short run
-			buf[1] = data[cur];
-			if(io->write_proc(buf, 2 * sizeof(BYTE), 1, handle) < 1)
-				return rgbe_Error(rgbe_write_error, NULL);
+			*dst++ = (BYTE)(128 + old_run_count);   // write short run
+			*dst++ = data[cur];
 			cur = beg_run;
 		}
 		// write out bytes until we reach the start of the next run 
@@ -475,68 +486,69 @@ rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes)
 			nonrun_count = beg_run - cur;
 			if (nonrun_count > 128) 
 				nonrun_count = 128;
-			buf[0] = (BYTE)nonrun_count;
-			if(io->write_proc(buf, sizeof(buf[0]), 1, handle) < 1)
-				return rgbe_Error(rgbe_write_error,NULL);
-			if(io->write_proc(&data[cur], sizeof(data[0]) * nonrun_count, 1, handle) < 1)
-				return rgbe_Error(rgbe_write_error,NULL);
+			*dst++ = (BYTE)nonrun_count;
+			memcpy(dst, &data[cur], nonrun_count);
+			dst += nonrun_count;
 			cur += nonrun_count;
 		}
 		// write out next run if one was found 
 		if (run_count >= MINRUNLENGTH) {
-			buf[0] = (BYTE)(128 + run_count);
-			buf[1] = data[beg_run];
-			if(io->write_proc(buf, sizeof(buf[0]) * 2, 1, handle) < 1)
-				return rgbe_Error(rgbe_write_error,NULL);
+			*dst++ = (BYTE)(128 + run_count);
+			*dst++ = data[beg_run];
 			cur += run_count;
 		}
 	}
 	
-	return TRUE;
+	return (int)(dst - out);
+}
+
+/**
+Worst case size of one RLE encoded scanline: the 4 byte scanline header, then 
+per channel every byte as a literal plus one count byte per 128 literals
+*/
+static inline size_t 
+rgbe_MaxScanlineSize_RLE(unsigned scanline_width) {
+	return 4 + 4 * (scanline_width + scanline_width / 128 + 1);
 }
 
+/**
+Encodes whole scanlines into a caller owned work buffer and hands each one to 
+the IO layer with a single write.
+@param channels Work buffer of 4 * scanline_width bytes
+@param encoded Work buffer of rgbe_MaxScanlineSize_RLE(scanline_width) bytes
+*/
 static BOOL 
-rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines) {
+rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines, BYTE *channels, BYTE *encoded) {
 	BYTE rgbe[4];
-	BYTE *buffer;
 	
 	if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
 		// run length encoding is not allowed so write flat
 		return rgbe_WritePixels(io, handle, data, scanline_width * num_scanlines);
 	}
-	buffer = (BYTE*)malloc(sizeof(BYTE) * 4 * scanline_width);
-	if (buffer == NULL) {
-		// no buffer space so write flat 
-		return rgbe_WritePixels(io, handle, data, scanline_width * num_scanlines);
-	}
 	while(num_scanlines-- > 0) {
-		rgbe[0] = (BYTE)2;
-		rgbe[1] = (BYTE)2;
-		rgbe[2] = (BYTE)(scanline_width >> 8);
-		rgbe[3] = (BYTE)(scanline_width & 0xFF);
-		if(io->write_proc(rgbe, sizeof(rgbe), 1, handle) < 1) {
-			free(buffer);
-			return rgbe_Error(rgbe_write_error, NULL);
-		}
+		BYTE *dst = encoded;
+		*dst++ = (BYTE)2;
+		*dst++ = (BYTE)2;
+		*dst++ = (BYTE)(scanline_width >> 8);
+		*dst++ = (BYTE)(scanline_width & 0xFF);
 		for(unsigned x = 0; x < scanline_width; x++) {
 			rgbe_FloatToRGBE(rgbe, data);
-			buffer[x] = rgbe[0];
-			buffer[x+scanline_width] = rgbe[1];
-			buffer[x+2*scanline_width] = rgbe[2];
-			buffer[x+3*scanline_width] = rgbe[3];
+			channels[x] = rgbe[0];
+			channels[x+scanline_width] = rgbe[1];
+			channels[x+2*scanline_width] = rgbe[2];
+			channels[x+3*scanline_width] = rgbe[3];
 			data ++;
 		}
-		// write out each of the four channels separately run length encoded
+		// each of the four channels separately run length encoded
 		// first red, then green, then blue, then exponent
 		for(int i = 0; i < 4; i++) {
-			BOOL bOK = rgbe_WriteBytes_RLE(io, handle, &buffer[i*scanline_width], scanline_width);
-			if(!bOK) {
-				free(buffer);
-				return bOK;
-			}
+			dst += rgbe_EncodeBytes_RLE(&channels[i*scanline_width], scanline_width, dst);
+		}
+		unsigned size = (unsigned)(dst - encoded);
+		if(io->write_proc(encoded, size, 1, handle) < 1) {
+			return rgbe_Error(rgbe_write_error, NULL);
 		}
 	}
-	free(buffer);
 	
 	return TRUE;
 }
@@ -680,16 +692,26 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		return FALSE;
 	}
 
-	// write each scanline
+	// write each scanline, reusing one set of work buffers
+
+	BYTE *channels = (BYTE*)malloc(sizeof(BYTE) * 4 * width);
+	BYTE *encoded = (BYTE*)malloc(rgbe_MaxScanlineSize_RLE(width));
+	BOOL bOK = TRUE;
 
-	for(unsigned y = 0; y < height; y++) {
+	for(unsigned y = 0; bOK && (y < height); y++) {
 		FIRGBF *scanline = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
-		if(!rgbe_WritePixels_RLE(io, handle, scanline, width, 1)) {
-			return FALSE;
+		if(channels && encoded) {
+			bOK = rgbe_WritePixels_RLE(io, handle, scanline, width, 1, channels, encoded);
+		} else {
+			// no buffer space so write flat
+			bOK = rgbe_WritePixels(io, handle, scanline, width);
 		}
 	}
 
-	return TRUE;
+	free(channels);
+	free(encoded);
+
+	return bOK;
 }
 
 // ==========================================================
@@ -23,6 +23,8 @@
 #include "Utilities.h"
 #include "ToneMapping.h"
 
+#include <algorithm>
+
 // ----------------------------------------------------------
 // Gradient domain HDR compression
 // Reference:
@@ -43,7 +45,6 @@ followed by a subsampling by 2.
 */
 static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 	FIBITMAP *h_dib = NULL, *v_dib = NULL, *dst = NULL;
-	float *src_pixel, *dst_pixel;
 
 	try {
 		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
@@ -60,11 +61,13 @@ static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 
 		// horizontal convolution dib -> h_dib
 
-		src_pixel = (float*)FreeImage_GetBits(dib);
-		dst_pixel = (float*)FreeImage_GetBits(h_dib);
+		const float *src_bits = (float*)FreeImage_GetBits(dib);
+		float *dst_bits = (float*)FreeImage_GetBits(h_dib);
 
-		for(unsigned y = 0; y < height; y++) {
+		ParallelForRows(0, height, width, [=](int y) {
 			// work on line y
+			const float *src_pixel = src_bits + y * pitch;
+			float *dst_pixel = dst_bits + y * pitch;
 			for(unsigned x = 2; x < width - 2; x++) {
 				dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
 				dst_pixel[x] /= 16;
@@ -74,30 +77,48 @@ static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 			dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
 			dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
 			dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
-
-			// next line
-			src_pixel += pitch;
-			dst_pixel += pitch;
-		}
+		});
 
 		// vertical convolution h_dib -> v_dib
-
-		src_pixel = (float*)FreeImage_GetBits(h_dib);
-		dst_pixel = (float*)FreeImage_GetBits(v_dib);
-
-		for(unsigned x = 0; x < width; x++) {		
-			// work on column x
-			for(unsigned y = 2; y < height - 2; y++) {
-				const unsigned index = y*pitch + x;
-				dst_pixel[index] = src_pixel[index-2*pitch] + src_pixel[index+2*pitch] + 4 * (src_pixel[index-pitch] + src_pixel[index+pitch]) + 6 * src_pixel[index];
-				dst_pixel[index] /= 16;
+		// done a line at a time rather than a column at a time, so the inner loop 
+		// walks contiguous memory
+
+		src_bits = (float*)FreeImage_GetBits(h_dib);
+		dst_bits = (float*)FreeImage_GetBits(v_dib);
+
+		ParallelForRows(0, height, width, [=](int y) {
+			// work on line y; rows r(k) are the lines y + k
+			const float *r0 = src_bits + y * pitch;
+			float *dst_pixel = dst_bits + y * pitch;
+			if(y >= 2 && (unsigned)y < height - 2) {
+				const float *rm2 = r0 - 2 * pitch, *rm1 = r0 - pitch, *rp1 = r0 + pitch, *rp2 = r0 + 2 * pitch;
+				for(unsigned x = 0; x < width; x++) {
+					dst_pixel[x] = (rm2[x] + rp2[x] + 4 * (rm1[x] + rp1[x]) + 6 * r0[x]) / 16;
+				}
 			}
 			// boundary mirroring
-			dst_pixel[x] = (2 * src_pixel[x+2*pitch] + 8 * src_pixel[x+pitch] + 6 * src_pixel[x]) / 16;
-			dst_pixel[x+pitch] = (src_pixel[x+3*pitch] + 4 * (src_pixel[x] + src_pixel[x+2*pitch]) + 7 * src_pixel[x+pitch]) / 16;
-			dst_pixel[(height-2)*pitch+x] = (src_pixel[(height-4)*pitch+x] + 5 * src_pixel[(height-1)*pitch+x] + 4 * src_pixel[(height-3)*pitch+x] + 6 * src_pixel[(height-2)*pitch+x]) / 16;
-			dst_pixel[(height-1)*pitch+x] = (src_pixel[(height-3)*pitch+x] + 5 * src_pixel[(height-2)*pitch+x] + 10 * src_pixel[(height-1)*pitch+x]) / 16;
-		}
+			else if(y == 0) {
+				const float *rp1 = r0 + pitch, *rp2 = r0 + 2 * pitch;
+				for(unsigned x = 0; x < width; x++) {
+					dst_pixel[x] = (2 * rp2[x] + 8 * rp1[x] + 6 * r0[x]) / 16;
+				}
+			} else if(y == 1) {
+				const float *rm1 = r0 - pitch, *rp1 = r0 + pitch, *rp2 = r0 + 2 * pitch;
+				for(unsigned x = 0; x < width; x++) {
+					dst_pixel[x] = (rp2[x] + 4 * (rm1[x] + rp1[x]) + 7 * r0[x]) / 16;
+				}
+			} else if((unsigned)y == height - 2) {
+				const float *rm2 = r0 - 2 * pitch, *rm1 = r0 - pitch, *rp1 = r0 + pitch;
+				for(unsigned x = 0; x < width; x++) {
+					dst_pixel[x] = (rm2[x] + 5 * rp1[x] + 4 * rm1[x] + 6 * r0[x]) / 16;
+				}
+			} else {
+				const float *rm2 = r0 - 2 * pitch, *rm1 = r0 - pitch;
+				for(unsigned x = 0; x < width; x++) {
+					dst_pixel[x] = (rm2[x] + 5 * rm1[x] + 10 * r0[x]) / 16;
+				}
+			}
+		});
 
 		FreeImage_Unload(h_dib); h_dib = NULL;
 
@@ -171,12 +192,19 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 		const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
 		
 		const float divider = (float)(1 << (k + 1));
-		float average = 0;
 		
-		float *src_pixel = (float*)FreeImage_GetBits(H);
-		float *dst_pixel = (float*)FreeImage_GetBits(G);
-
-		for(unsigned y = 0; y < height; y++) {
+		const float *src_pixel = (float*)FreeImage_GetBits(H);
+		float *dst_bits = (float*)FreeImage_GetBits(G);
+
+		// per-line sums, added up in order afterwards so the average 
+		// doesn't depend on the number of threads
+		std::vector<double> line_sum(height);
+		double *line_average = &line_sum[0];
+
+		ParallelForRows(0, height, width, [=](int row) {
+			const unsigned y = row;
+			float *dst_pixel = dst_bits + y * pitch;
+			float average = 0;
 			const unsigned n = (y == 0 ? 0 : y-1);
 			const unsigned s = (y+1 == height ? y : y+1);
 			for(unsigned x = 0; x < width; x++) {
@@ -190,11 +218,14 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 				// average gradient
 				average += dst_pixel[x];
 			}
-			// next line
-			dst_pixel += pitch;
+			line_average[y] = average;
+		});
+
+		double average = 0;
+		for(unsigned y = 0; y < height; y++) {
+			average += line_sum[y];
 		}
-		
-		*avgGrad = average / (width * height);
+		*avgGrad = (float)(average / (width * height));
 
 		return G;
 
@@ -241,7 +272,8 @@ Compute the gradient attenuation function PHI(x, y)
 @return Returns the attenuation matrix Phi if successful, returns NULL otherwise
 */
 static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, float alpha, float beta) {
-	float *src_pixel, *dst_pixel;
+	const float *src_bits;
+	float *dst_bits;
 	FIBITMAP **phi = NULL;
 
 	try {
@@ -268,35 +300,33 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 			phi[k] = FreeImage_AllocateT(FIT_FLOAT, width, height);
 			if(!phi[k]) throw(1);
 			
-			src_pixel = (float*)FreeImage_GetBits(Gk);
-			dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-			for(unsigned y = 0; y < height; y++) {
+			src_bits = (float*)FreeImage_GetBits(Gk);
+			dst_bits = (float*)FreeImage_GetBits(phi[k]);
+			ParallelForRows(0, height, width, [=](int y) {
+				const float *src_pixel = src_bits + y * pitch;
+				float *dst_pixel = dst_bits + y * pitch;
 				for(unsigned x = 0; x < width; x++) {
 					// compute (alpha / grad) * (grad / alpha) ** beta
 					const float v = src_pixel[x] / ALPHA;
 					const float value = (float)pow((float)v, (float)(beta-1));
 					dst_pixel[x] = (value > 1) ? 1 : value;
 				}
-				// next line
-				src_pixel += pitch;
-				dst_pixel += pitch;
-			}
+			});
 
 			if(k < nlevels-1) {
 				// compute PHI(k) = L( PHI(k+1) ) * phi(k)
 				FIBITMAP *L = FreeImage_Rescale(phi[k+1], width, height, FILTER_BILINEAR);
 				if(!L) throw(1);
 
-				src_pixel = (float*)FreeImage_GetBits(L);
-				dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-				for(unsigned y = 0; y < height; y++) {
+				src_bits = (float*)FreeImage_GetBits(L);
+				dst_bits = (float*)FreeImage_GetBits(phi[k]);
+				ParallelForRows(0, height, width, [=](int y) {
+					const float *src_pixel = src_bits + y * pitch;
+					float *dst_pixel = dst_bits + y * pitch;
 					for(unsigned x = 0; x < width; x++) {
 						dst_pixel[x] *= src_pixel[x];
 					}
-					// next line
-					src_pixel += pitch;
-					dst_pixel += pitch;
-				}
+				});
 
 				FreeImage_Unload(L);
 
@@ -335,7 +365,8 @@ then compute the divergence div G from the attenuated gradient.
 */
 static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 	FIBITMAP *Gx = NULL, *Gy = NULL, *divG = NULL;
-	float *phi, *h, *gx, *gy, *divg;
+	const float *phi, *h;
+	float *gx, *gy, *divg;
 
 	try {
 		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(H);
@@ -358,21 +389,21 @@ static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 		gx  = (float*)FreeImage_GetBits(Gx);
 		gy  = (float*)FreeImage_GetBits(Gy);
 
-		for(unsigned y = 0; y < height; y++) {
+		ParallelForRows(0, height, width, [=](int row) {
+			const unsigned y = row;
 			const unsigned s = (y+1 == height ? y : y+1);
+			float *gx_line = gx + y * pitch;
+			float *gy_line = gy + y * pitch;
 			for(unsigned x = 0; x < width; x++) {				
 				const unsigned e = (x+1 == width ? x : x+1);
 				// forward difference
 				const unsigned index = y*pitch + x;
 				const float phi_xy = phi[index];
 				const float h_xy   = h[index];
-				gx[x] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
-				gy[x] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
+				gx_line[x] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
+				gy_line[x] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
 			}
-			// next line
-			gx += pitch;
-			gy += pitch;
-		}
+		});
 
 		// calculate the divergence
 
@@ -383,7 +414,8 @@ static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 		gy  = (float*)FreeImage_GetBits(Gy);
 		divg = (float*)FreeImage_GetBits(divG);
 
-		for(unsigned y = 0; y < height; y++) {
+		ParallelForRows(0, height, width, [=](int row) {
+			const unsigned y = row;
 			for(unsigned x = 0; x < width; x++) {				
 				// backward difference approximation
 				// divG = Gx(x, y) - Gx(x-1, y) + Gy(x, y) - Gy(x, y-1)
@@ -392,7 +424,7 @@ static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
 				if(x > 0) divg[index] -= gx[index-1];
 				if(y > 0) divg[index] -= gy[index-pitch];
 			}
-		}
+		});
 
 		// no longer needed ... 
 		FreeImage_Unload(Gx);
@@ -427,34 +459,36 @@ static FIBITMAP* LogLuminance(FIBITMAP *Y) {
 		const unsigned height = FreeImage_GetHeight(H);
 		const unsigned pitch  = FreeImage_GetPitch(H);
 
-		// find max & min luminance values
-		float maxLum = -1e20F, minLum = 1e20F;
+		// find max & min luminance values, line by line
+		std::vector<float> line_max(height), line_min(height);
+		float *line_max_bits = &line_max[0];
+		float *line_min_bits = &line_min[0];
 
 		BYTE *bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			const float *pixel = (float*)bits;
+		ParallelForRows(0, height, width, [=](int y) {
+			const float *pixel = (float*)(bits + y * pitch);
+			float maxLum = -1e20F, minLum = 1e20F;
 			for(unsigned x = 0; x < width; x++) {
 				const float value = pixel[x];
 				maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
 				minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
 			}
-			// next line
-			bits += pitch;
-		}
+			line_max_bits[y] = maxLum;
+			line_min_bits[y] = minLum;
+		});
+		const float maxLum = *std::max_element(line_max.begin(), line_max.end());
+		const float minLum = *std::min_element(line_min.begin(), line_min.end());
 		if(maxLum == minLum) throw(1);
 
 		// normalize to range 0..100 and take the logarithm
 		const float scale = 100.F / (maxLum - minLum);
-		bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			float *pixel = (float*)bits;
+		ParallelForRows(0, height, width, [=](int y) {
+			float *pixel = (float*)(bits + y * pitch);
 			for(unsigned x = 0; x < width; x++) {
 				const float value = (pixel[x] - minLum) * scale;
 				pixel[x] = log(value + EPSILON);
 			}
-			// next line
-			bits += pitch;
-		}
+		});
 
 		return H;
 
@@ -474,13 +508,12 @@ static void ExpLuminance(FIBITMAP *Y) {
 	const unsigned pitch = FreeImage_GetPitch(Y);
 
 	BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
+	ParallelForRows(0, height, width, [=](int y) {
+		float *pixel = (float*)(bits + y * pitch);
 		for(unsigned x = 0; x < width; x++) {
 			pixel[x] = exp(pixel[x]) - EPSILON;
 		}
-		bits += pitch;
-	}
+	});
 }
 
 // --------------------------------------------------------------------------
@@ -650,20 +683,17 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		BYTE *bits_yin  = (BYTE*)FreeImage_GetBits(Yin);
 		BYTE *bits_yout = (BYTE*)FreeImage_GetBits(Yout);
 
-		for(unsigned y = 0; y < height; y++) {
-			float *Lin = (float*)bits_yin;
-			float *Lout = (float*)bits_yout;
-			float *color = (float*)bits;
+		ParallelForRows(0, height, width, [=](int y) {
+			const float *Lin = (float*)(bits_yin + y * y_pitch);
+			const float *Lout = (float*)(bits_yout + y * y_pitch);
+			float *color = (float*)(bits + y * rgb_pitch);
 			for(unsigned x = 0; x < width; x++) {
 				for(unsigned c = 0; c < 3; c++) {
 					*color = (Lin[x] > 0) ? pow(*color/Lin[x], s) * Lout[x] : 0;
 					color++;
 				}
 			}
-			bits += rgb_pitch;
-			bits_yin += y_pitch;
-			bits_yout += y_pitch;
-		}
+		});
 
 		// not needed anymore
 		FreeImage_Unload(Yin);  Yin  = NULL;
@@ -58,21 +58,17 @@ static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
 	const float *uf_bits = (float*)FreeImage_GetBits(UF);
 
 	// interior points
-	{
-		float *uc_scan = uc_bits + uc_pitch;
-		for (row_uc = 1, row_uf = 2; row_uc < nc-1; row_uc++, row_uf += 2) {
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uc = 1, col_uf = 2; col_uc < nc-1; col_uc++, col_uf += 2) { 
-				// calculate 
-				// UC(row_uc, col_uc) = 
-				// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
-				float *uc_pixel = uc_scan + col_uc;
-				const float *uf_center = uf_scan + col_uf;
-				*uc_pixel = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
-			}
-			uc_scan += uc_pitch;
+	ParallelForRows(1, nc-1, nc, [=](int row_uc) {
+		float *uc_scan = uc_bits + row_uc * uc_pitch;
+		const float *uf_scan = uf_bits + 2 * row_uc * uf_pitch;
+		for (int col_uc = 1; col_uc < nc-1; col_uc++) { 
+			// calculate 
+			// UC(row_uc, col_uc) = 
+			// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
+			const int col_uf = 2 * col_uc;
+			uc_scan[col_uc] = 0.5F * uf_scan[col_uf] + 0.125F * ( uf_scan[col_uf + uf_pitch] + uf_scan[col_uf - uf_pitch] + uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
 		}
-	}
+	});
 	// boundary points
 	const int ncc = 2*nc-1;
 	{
@@ -99,13 +95,13 @@ static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
 			UC(nc-1, col_uc) = UF(ncc-1, col_uf);
 		}
 		*/
-		float *uc_scan_top = uc_bits;
-		float *uc_scan_bottom = uc_bits + (nc-1)*uc_pitch;
-		const float *uf_scan_top = uf_bits + (ncc-1)*uf_pitch;
-		const float *uf_scan_bottom = uf_bits;
+		float *uc_scan_first = uc_bits;
+		float *uc_scan_last = uc_bits + (nc-1)*uc_pitch;
+		const float *uf_scan_first = uf_bits;
+		const float *uf_scan_last = uf_bits + (ncc-1)*uf_pitch;
 		for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-			uc_scan_top[col_uc] = uf_scan_top[col_uf];
-			uc_scan_bottom[col_uc] = uf_scan_bottom[col_uf];
+			uc_scan_first[col_uc] = uf_scan_first[col_uf];
+			uc_scan_last[col_uc] = uf_scan_last[col_uf];
 		}
 	}
 }
@@ -130,50 +126,39 @@ solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2 + 1. The fine-grid so
 returned in uf[0..nf-1][0..nf-1].
 */
 static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nf) {
-	int row_uc, row_uf, col_uc, col_uf;
-
 	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
 	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
 	
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *uc_bits = (float*)FreeImage_GetBits(UC);
-	
-	// do elements that are copies
-	{
-		const int nc = nf/2 + 1;
-
-		float *uf_scan = uf_bits;
-		const float *uc_scan = uc_bits;		
-		for (row_uc = 0; row_uc < nc; row_uc++) {
-			for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-				// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
-				uf_scan[col_uf] = uc_scan[col_uc];
-			}
-			uc_scan += uc_pitch;
-			uf_scan += 2 * uf_pitch;
+
+	const int nc = nf/2 + 1;
+
+	// even-numbered rows: copy the coarse row into the even-numbered columns, 
+	// then interpolate the odd-numbered columns horizontally
+	ParallelForRows(0, nc, nf, [=](int row_uc) {
+		float *uf_scan = uf_bits + 2 * row_uc * uf_pitch;
+		const float *uc_scan = uc_bits + row_uc * uc_pitch;
+		for (int col_uc = 0; col_uc < nc; col_uc++) {
+			// calculate UF(2*row_uc, 2*col_uc) = UC(row_uc, col_uc);
+			uf_scan[2 * col_uc] = uc_scan[col_uc];
 		}
-	}
-	// do odd-numbered columns, interpolating vertically
-	{		
-		for(row_uf = 1; row_uf < nf-1; row_uf += 2) {
-			float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uf = 0; col_uf < nf; col_uf += 2) {
-				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
-				uf_scan[col_uf] = 0.5F * ( *(uf_scan + uf_pitch + col_uf) + *(uf_scan - uf_pitch + col_uf) );
-			}
+		for (int col_uf = 1; col_uf < nf-1; col_uf += 2) {
+			// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) )
+			uf_scan[col_uf] = 0.5F * ( uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
 		}
-	}
-	// do even-numbered columns, interpolating horizontally
-	{
-		float *uf_scan = uf_bits;
-		for(row_uf = 0; row_uf < nf; row_uf++) {
-			for (col_uf = 1; col_uf < nf-1; col_uf += 2) {
-				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) )
-				uf_scan[col_uf] = 0.5F * ( uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
-			}
-			uf_scan += uf_pitch;
+	});
+	// odd-numbered rows, interpolating whole rows vertically 
+	// (the odd columns get the mean of their four coarse neighbours either way)
+	ParallelForRows(0, nc-1, nf, [=](int k) {
+		float *uf_scan = uf_bits + (2 * k + 1) * uf_pitch;
+		const float *above = uf_scan + uf_pitch;
+		const float *below = uf_scan - uf_pitch;
+		for (int col_uf = 0; col_uf < nf; col_uf++) {
+			// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
+			uf_scan[col_uf] = 0.5F * ( above[col_uf] + below[col_uf] );
 		}
-	}
+	});
 }
 
 /**
@@ -181,7 +166,7 @@ Red-black Gauss-Seidel relaxation for model problem. Updates the current value o
 u[0..n-1][0..n-1], using the right-hand side function rhs[0..n-1][0..n-1].
 */
 static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col, ipass, isw, jsw;
+	int ipass, jsw;
 	const float h = 1.0F / (n - 1);
 	const float h2 = h*h;
 
@@ -192,22 +177,19 @@ static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
 	for (ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
-		float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1, isw = jsw; row < n-1; row++, isw = 3-isw) {
-			for (col = isw; col < n-1; col += 2) { 
+		// a sweep only reads points of the other colour, so its rows are independent
+		ParallelForRows(1, n-1, n, [=](int row) {
+			const int isw = (row & 1) ? jsw : 3 - jsw;
+			float *u_scan = u_bits + row * u_pitch;
+			const float *rhs_scan = rhs_bits + row * rhs_pitch;
+			for (int col = isw; col < n-1; col += 2) { 
 				// Gauss-Seidel formula
 				// calculate U(row, col) = 
 				// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
-				float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
-				*u_center -= h2 * *rhs_center;
-				*u_center *= 0.25F;
+				const float sum = u_scan[col + u_pitch] + u_scan[col - u_pitch] + u_scan[col + 1] + u_scan[col - 1];
+				u_scan[col] = (sum - h2 * rhs_scan[col]) * 0.25F;
 			}
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
+		});
 	}
 }
 
@@ -216,8 +198,6 @@ Returns minus the residual for the model problem. Input quantities are u[0..n-1]
 rhs[0..n-1][0..n-1], while res[0..n-1][0..n-1] is returned.
 */
 static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col;
-
 	const float h = 1.0F / (n-1);	
 	const float h2i = 1.0F / (h*h);
 
@@ -230,26 +210,17 @@ static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
 	// interior points
-	{
-		float *res_scan = res_bits + res_pitch;
-		const float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1; row < n-1; row++) {
-			for (col = 1; col < n-1; col++) {
-				// calculate RES(row, col) = 
-				// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
-				float *res_center = res_scan + col;
-				const float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*res_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1) - 4 * *u_center;
-				*res_center *= -h2i;
-				*res_center += *rhs_center;
-			}
-			res_scan += res_pitch;
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
+	ParallelForRows(1, n-1, n, [=](int row) {
+		float *res_scan = res_bits + row * res_pitch;
+		const float *u_scan = u_bits + row * u_pitch;
+		const float *rhs_scan = rhs_bits + row * rhs_pitch;
+		for (int col = 1; col < n-1; col++) {
+			// calculate RES(row, col) = 
+			// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
+			const float laplacian = u_scan[col + u_pitch] + u_scan[col - u_pitch] + u_scan[col + 1] + u_scan[col - 1] - 4 * u_scan[col];
+			res_scan[col] = laplacian * -h2i + rhs_scan[col];
 		}
-	}
+	});
 
 	// boundary points
 	{
@@ -280,14 +251,14 @@ static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nf) {
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *res_bits = (float*)FreeImage_GetBits(RES);
 
-	for(int row = 0; row < nf; row++) {
+	ParallelForRows(0, nf, nf, [=](int row) {
+		float *uf_scan = uf_bits + row * uf_pitch;
+		const float *res_scan = res_bits + row * res_pitch;
 		for(int col = 0; col < nf; col++) {
 			// calculate UF(row, col) = UF(row, col) + RES(row, col);
-			uf_bits[col] += res_bits[col];
+			uf_scan[col] += res_scan[col];
 		}
-		uf_bits += uf_pitch;
-		res_bits += res_pitch;
-	}
+	});
 }
 
 /**
@@ -22,6 +22,10 @@
 
 #include "Resize.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 /**
   Filter weights table.
   This class stores contribution information for an entire line (row or column).
@@ -217,6 +221,150 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 } 
 
 
+// ---------------------------------------------
+// Filter kernels shared by all pixel types.
+// Rows of the destination are independent, so both passes are split into bands of rows 
+// running on separate threads. The vertical pass walks whole source lines rather than 
+// columns, keeping memory accesses contiguous.
+
+/// Clamps and rounds a filtered value into a destination sample
+static inline void StoreFiltered(BYTE &dst, double value) {
+	dst = (BYTE)MIN(MAX((int)0, (int)(value + 0.5)), (int)255);
+}
+
+static inline void StoreFiltered(WORD &dst, double value) {
+	dst = (WORD)MIN(MAX((int)0, (int)(value + 0.5)), (int)0xFFFF);
+}
+
+static inline void StoreFiltered(float &dst, double value) {
+	dst = (float)value;
+}
+
+/**
+Horizontal pass for 1 to 4 samples of type T per pixel
+@param samplespp Samples per pixel
+*/
+template <class T> static void 
+FilterRows(CWeightsTable &weightsTable, FIBITMAP *src, FIBITMAP *dst, unsigned samplespp, unsigned dst_width, unsigned dst_height) {
+	ParallelForRows(0, dst_height, dst_width * samplespp, [&](int y) {
+		// scale each row 
+		const T *src_bits = (T*)FreeImage_GetScanLine(src, y);
+		T *dst_bits = (T*)FreeImage_GetScanLine(dst, y);
+
+		for(unsigned x = 0; x < dst_width; x++) {
+			// loop through row
+			double value[4] = {0, 0, 0, 0};					// 4 = RGBA max
+			const int iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
+			const int iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
+
+			for(int i = iLeft; i <= iRight; i++) {
+				// scan between boundaries
+				// accumulate weighted effect of each neighboring pixel
+				const double weight = weightsTable.getWeight(x, i-iLeft);
+				const T *pixel = src_bits + i * samplespp;
+				for (unsigned j = 0; j < samplespp; j++) {
+					value[j] += (weight * (double)pixel[j]); 
+				}
+			} 
+
+			// clamp and place result in destination pixel
+			for (unsigned j = 0; j < samplespp; j++) {
+				StoreFiltered(dst_bits[j], value[j]);
+			}
+
+			dst_bits += samplespp;
+		} 
+	});
+}
+
+/**
+Vertical pass over lines of line_length samples of type T
+*/
+template <class T> static void 
+FilterColumns(CWeightsTable &weightsTable, FIBITMAP *src, FIBITMAP *dst, unsigned line_length, unsigned dst_height) {
+	ParallelForRows(0, dst_height, line_length, [&](int y) {
+		// accumulate every source line contributing to line y
+		std::vector<double> value(line_length, 0.0);
+		const int iLeft = weightsTable.getLeftBoundary(y);    // retrieve left boundary
+		const int iRight = weightsTable.getRightBoundary(y);  // retrieve right boundary
+
+		for(int i = iLeft; i <= iRight; i++) {
+			const double weight = weightsTable.getWeight(y, i-iLeft);
+			const T *src_bits = (T*)FreeImage_GetScanLine(src, i);
+			for(unsigned k = 0; k < line_length; k++) {
+				value[k] += (weight * (double)src_bits[k]);
+			}
+		}
+
+		// clamp and place result in destination line
+		T *dst_bits = (T*)FreeImage_GetScanLine(dst, y);
+		for(unsigned k = 0; k < line_length; k++) {
+			StoreFiltered(dst_bits[k], value[k]);
+		}
+	});
+}
+
+#ifdef __SSE__
+
+/**
+Horizontal pass for FIT_RGBAF: one pixel is one SSE register. 
+Accumulates in single precision, unlike the generic path.
+*/
+static void 
+FilterRowsRGBAF(CWeightsTable &weightsTable, FIBITMAP *src, FIBITMAP *dst, unsigned dst_width, unsigned dst_height) {
+	ParallelForRows(0, dst_height, dst_width * 4, [&](int y) {
+		const float *src_bits = (float*)FreeImage_GetScanLine(src, y);
+		float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
+
+		for(unsigned x = 0; x < dst_width; x++) {
+			const int iLeft = weightsTable.getLeftBoundary(x);
+			const int iRight = weightsTable.getRightBoundary(x);
+
+			__m128 value = _mm_setzero_ps();
+			for(int i = iLeft; i <= iRight; i++) {
+				const __m128 weight = _mm_set1_ps((float)weightsTable.getWeight(x, i-iLeft));
+				value = _mm_add_ps(value, _mm_mul_ps(weight, _mm_loadu_ps(src_bits + 4 * i)));
+			}
+			_mm_storeu_ps(dst_bits + 4 * x, value);
+		}
+	});
+}
+
+/**
+Vertical pass for float images of any channel count, four samples at a time. 
+Accumulates in single precision, unlike the generic path.
+*/
+static void 
+FilterColumnsFloat(CWeightsTable &weightsTable, FIBITMAP *src, FIBITMAP *dst, unsigned line_length, unsigned dst_height) {
+	ParallelForRows(0, dst_height, line_length, [&](int y) {
+		const int iLeft = weightsTable.getLeftBoundary(y);
+		const int iRight = weightsTable.getRightBoundary(y);
+
+		// the destination line is the accumulator
+		float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
+		memset(dst_bits, 0, line_length * sizeof(float));
+
+		const unsigned simd_length = line_length & ~3U;
+		for(int i = iLeft; i <= iRight; i++) {
+			const float w = (float)weightsTable.getWeight(y, i-iLeft);
+			const __m128 weight = _mm_set1_ps(w);
+			const float *src_bits = (float*)FreeImage_GetScanLine(src, i);
+			unsigned k = 0;
+			for(; k < simd_length; k += 4) {
+				const __m128 sum = _mm_add_ps(_mm_loadu_ps(dst_bits + k), _mm_mul_ps(weight, _mm_loadu_ps(src_bits + k)));
+				_mm_storeu_ps(dst_bits + k, sum);
+			}
+			for(; k < line_length; k++) {
+				dst_bits[k] += w * src_bits[k];
+			}
+		}
+	});
+}
+
+#endif // __SSE__
+
+// ---------------------------------------------
+
 /// Performs horizontal image filtering
 void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned src_height, FIBITMAP *dst, unsigned dst_width, unsigned dst_height) { 
 	if(dst_width == src_width) {
@@ -244,8 +392,6 @@ void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned
 		}
 	}
 	else {
-		unsigned index;	// pixel index
-
 		// allocate and calculate the contributions
 		CWeightsTable weightsTable(m_pFilter, dst_width, src_width); 
 		
@@ -259,7 +405,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned
 						// scale and convert to 8-bit
 						if(FreeImage_GetBPP(dst) != 8) break;
 
-						for(unsigned y = 0; y < dst_height; y++) {
+						ParallelForRows(0, dst_height, dst_width, [&](int y) {
 							// scale each row 
 							BYTE *src_bits = FreeImage_GetScanLine(src, y);
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -283,7 +429,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned
 								// clamp and place result in destination pixel
 								dst_bits[x] = (BYTE)MIN(MAX((int)0, (int)(value + 0.5)), (int)255);
 							} 
-						}
+						});
 					}
 					break;
 
@@ -294,36 +440,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned
 						// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
 						unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-						for(unsigned y = 0; y < dst_height; y++) {
-							// scale each row 
-							BYTE *src_bits = FreeImage_GetScanLine(src, y);
-							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
-
-							for(unsigned x = 0; x < dst_width; x++) {
-								// loop through row
-								double value[4] = {0, 0, 0, 0};					// 4 = 32bpp max
-								int iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
-								int iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-
-								for(int i = iLeft; i <= iRight; i++) {
-									// scan between boundaries
-									// accumulate weighted effect of each neighboring pixel
-									double weight = weightsTable.getWeight(x, i-iLeft);
-									
-									index = i * bytespp;
-									for (unsigned j = 0; j < bytespp; j++) {
-										value[j] += (weight * (double)src_bits[index++]); 
-									}
-								} 
-
-								// clamp and place result in destination pixel
-								for (unsigned j = 0; j < bytespp; j++) {
-									dst_bits[j] = (BYTE)MIN(MAX((int)0, (int)(value[j] + 0.5)), (int)255);
-								}
-
-								dst_bits += bytespp;
-							} 
-						}
+						FilterRows<BYTE>(weightsTable, src, dst, bytespp, dst_width, dst_height);
 					}
 					break;
 				}
@@ -337,36 +454,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned
 				// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 				unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
-				for(unsigned y = 0; y < dst_height; y++) {
-					// scale each row 
-					WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y);
-					WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
-
-					for(unsigned x = 0; x < dst_width; x++) {
-						// loop through row
-						double value[4] = {0, 0, 0, 0};					// 4 = 64bpp max
-						int iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
-						int iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-
-						for(int i = iLeft; i <= iRight; i++) {
-							// scan between boundaries
-							// accumulate weighted effect of each neighboring pixel
-							double weight = weightsTable.getWeight(x, i-iLeft);
-							
-							index = i * wordspp;
-							for (unsigned j = 0; j < wordspp; j++) {
-								value[j] += (weight * (double)src_bits[index++]); 
-							}
-						} 
-
-						// clamp and place result in destination pixel
-						for (unsigned j = 0; j < wordspp; j++) {
-							dst_bits[j] = (WORD)MIN(MAX((int)0, (int)(value[j] + 0.5)), (int)0xFFFF);
-						}
-
-						dst_bits += wordspp;
-					} 
-				}
+				FilterRows<WORD>(weightsTable, src, dst, wordspp, dst_width, dst_height);
 			}
 			break;
 
@@ -377,36 +465,13 @@ void CResizeEngine::horizontalFilter(FIBITMAP *src, unsigned src_width, unsigned
 				// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
 				unsigned floatspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(float);
 
-				for(unsigned y = 0; y < dst_height; y++) {
-					// scale each row 
-					float *src_bits = (float*)FreeImage_GetScanLine(src, y);
-					float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
-
-					for(unsigned x = 0; x < dst_width; x++) {
-						// loop through row
-						double value[4] = {0, 0, 0, 0};					// 4 = 64bpp max
-						int iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
-						int iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-
-						for(int i = iLeft; i <= iRight; i++) {
-							// scan between boundaries
-							// accumulate weighted effect of each neighboring pixel
-							double weight = weightsTable.getWeight(x, i-iLeft);
-							
-							index = i * floatspp;
-							for (unsigned j = 0; j < floatspp; j++) {
-								value[j] += (weight * (double)src_bits[index++]); 
-							}
-						} 
-
-						// place result in destination pixel
-						for (unsigned j = 0; j < floatspp; j++) {
-							dst_bits[j] = (float)value[j];
-						}
-
-						dst_bits += floatspp;
-					} 
+#ifdef __SSE__
+				if(floatspp == 4) {
+					FilterRowsRGBAF(weightsTable, src, dst, dst_width, dst_height);
+					break;
 				}
+#endif
+				FilterRows<float>(weightsTable, src, dst, floatspp, dst_width, dst_height);
 			}
 			break;
 
@@ -442,13 +507,13 @@ void CResizeEngine::verticalFilter(FIBITMAP *src, unsigned src_width, unsigned s
 
 	}
 	else {
-		unsigned index;	// pixel index
-
 		// allocate and calculate the contributions
 		CWeightsTable weightsTable(m_pFilter, dst_height, src_height); 
 
+		// samples per line
+		const unsigned line_length = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) * dst_width;
 
-		// step through columns
+		// step through lines
 		switch(FreeImage_GetImageType(src)) {
 			case FIT_BITMAP:
 			{
@@ -461,7 +526,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *src, unsigned src_width, unsigned s
 						unsigned src_pitch = FreeImage_GetPitch(src);
 						unsigned dst_pitch = FreeImage_GetPitch(dst);
 
-						for(unsigned x = 0; x < dst_width; x++) {
+						// columns are independent too
+						ParallelForRows(0, dst_width, dst_height, [&](int x) {
 
 							// work on column x in dst
 							BYTE *dst_bits = FreeImage_GetBits(dst) + x;
@@ -492,56 +558,15 @@ void CResizeEngine::verticalFilter(FIBITMAP *src, unsigned src_width, unsigned s
 
 								dst_bits += dst_pitch;
 							}
-						}
+						});
 					}
 					break;
 
 					case 8:
 					case 24:
 					case 32:
-					{
-						// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-						unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-						unsigned src_pitch = FreeImage_GetPitch(src);
-						unsigned dst_pitch = FreeImage_GetPitch(dst);
-
-						for(unsigned x = 0; x < dst_width; x++) {
-							index = x * bytespp;
-
-							// work on column x in dst
-							BYTE *dst_bits = FreeImage_GetBits(dst) + index;
-
-							// scale each column
-							for(unsigned y = 0; y < dst_height; y++) {
-								// loop through column
-								double value[4] = {0, 0, 0, 0};					// 4 = 32bpp max
-								int iLeft = weightsTable.getLeftBoundary(y);    // retrieve left boundary
-								int iRight = weightsTable.getRightBoundary(y);  // retrieve right boundary
-
-								BYTE *src_bits = FreeImage_GetScanLine(src, iLeft) + index;
-
-								for(int i = iLeft; i <= iRight; i++) {
-									// scan between boundaries
-									// accumulate weighted effect of each neighboring pixel
-									double weight = weightsTable.getWeight(y, i-iLeft);							
-									for (unsigned j = 0; j < bytespp; j++) {
-										value[j] += (weight * (double)src_bits[j]);
-									}
-
-									src_bits += src_pitch;
-								}
-
-								// clamp and place result in destination pixel
-								for (unsigned j = 0; j < bytespp; j++) {
-									dst_bits[j] = (BYTE)MIN(MAX((int)0, (int)(value[j] + 0.5)), (int)255);
-								}
-
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-					break;
+						FilterColumns<BYTE>(weightsTable, src, dst, line_length, dst_height);
+						break;
 				}
 			}
 			break;
@@ -549,98 +574,19 @@ void CResizeEngine::verticalFilter(FIBITMAP *src, unsigned src_width, unsigned s
 			case FIT_UINT16:
 			case FIT_RGB16:
 			case FIT_RGBA16:
-			{
-				// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-				unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
-
-				unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
-				unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
-
-				for(unsigned x = 0; x < dst_width; x++) {
-					index = x * wordspp;
-
-					// work on column x in dst
-					WORD *dst_bits = (WORD*)FreeImage_GetBits(dst) + index;
-
-					// scale each column
-					for(unsigned y = 0; y < dst_height; y++) {
-						// loop through column
-						double value[4] = {0, 0, 0, 0};					// 4 = 64bpp max
-						int iLeft = weightsTable.getLeftBoundary(y);    // retrieve left boundary
-						int iRight = weightsTable.getRightBoundary(y);  // retrieve right boundary
-
-						WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, iLeft) + index;
-
-						for(int i = iLeft; i <= iRight; i++) {
-							// scan between boundaries
-							// accumulate weighted effect of each neighboring pixel
-							double weight = weightsTable.getWeight(y, i-iLeft);							
-							for (unsigned j = 0; j < wordspp; j++) {
-								value[j] += (weight * (double)src_bits[j]);
-							}
-
-							src_bits += src_pitch;
-						}
-
-						// clamp and place result in destination pixel
-						for (unsigned j = 0; j < wordspp; j++) {
-							dst_bits[j] = (WORD)MIN(MAX((int)0, (int)(value[j] + 0.5)), (int)0xFFFF);
-						}
-
-						dst_bits += dst_pitch;
-					}
-				}
-			}
-			break;
+				FilterColumns<WORD>(weightsTable, src, dst, line_length / sizeof(WORD), dst_height);
+				break;
 
 			case FIT_FLOAT:
 			case FIT_RGBF:
 			case FIT_RGBAF:
-			{
-				// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-				unsigned floatspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(float);
-
-				unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
-				unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
-
-				for(unsigned x = 0; x < dst_width; x++) {
-					index = x * floatspp;
-
-					// work on column x in dst
-					float *dst_bits = (float*)FreeImage_GetBits(dst) + index;
-
-					// scale each column
-					for(unsigned y = 0; y < dst_height; y++) {
-						// loop through column
-						double value[4] = {0, 0, 0, 0};					// 4 = 64bpp max
-						int iLeft = weightsTable.getLeftBoundary(y);    // retrieve left boundary
-						int iRight = weightsTable.getRightBoundary(y);  // retrieve right boundary
-
-						float *src_bits = (float*)FreeImage_GetScanLine(src, iLeft) + index;
-
-						for(int i = iLeft; i <= iRight; i++) {
-							// scan between boundaries
-							// accumulate weighted effect of each neighboring pixel
-							double weight = weightsTable.getWeight(y, i-iLeft);							
-							for (unsigned j = 0; j < floatspp; j++) {
-								value[j] += (weight * (double)src_bits[j]);
-							}
-
-							src_bits += src_pitch;
-						}
-
-						// clamp and place result in destination pixel
-						for (unsigned j = 0; j < floatspp; j++) {
-							dst_bits[j] = (float)value[j];
-						}
-
-						dst_bits += dst_pitch;
-					}
-				}
-			}
-			break;
+#ifdef __SSE__
+				FilterColumnsFloat(weightsTable, src, dst, line_length / sizeof(float), dst_height);
+#else
+				FilterColumns<float>(weightsTable, src, dst, line_length / sizeof(float), dst_height);
+#endif
+				break;
 
 		}
 	}
-} 
-
+}
@@ -3,7 +3,9 @@
 // and you want OpenEXR to use it for multithreaded file I/O.
 //
 
-#undef HAVE_PTHREAD		// currently disabled in FreeImage
+#if !defined _WIN32 && !defined _WIN64
+#define HAVE_PTHREAD 1
+#endif
 
 //
 // Define and set to 1 if the target system supports POSIX semaphores
@@ -11,7 +13,10 @@
 // own semaphore implementation.
 //
 
-#undef HAVE_POSIX_SEMAPHORES
+// (Darwin only has named semaphores; use the mutex-based fallback there)
+#if !defined _WIN32 && !defined _WIN64 && !defined __APPLE__
+#define HAVE_POSIX_SEMAPHORES 1
+#endif
 
 //
 // Define and set to 1 if the target system is a Darwin-based system
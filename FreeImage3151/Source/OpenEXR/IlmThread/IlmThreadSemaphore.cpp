@@ -41,7 +41,7 @@
 
 #include "IlmBaseConfig.h"
 
-//#if !defined (_WIN32) && !(_WIN64) && !(HAVE_PTHREAD)
+#if !defined (_WIN32) && !(_WIN64) && !(HAVE_PTHREAD)
 #include "IlmThreadSemaphore.h"
 
 namespace IlmThread {
@@ -57,4 +57,4 @@ int Semaphore::value () const {return 0;}
 
 } // namespace IlmThread
 
-//#endif
+#endif
@@ -50,6 +50,10 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 // ==========================================================
 //   Bitmap palette and pixels alignment
@@ -191,6 +195,149 @@ MAXMIN(const T* L, long n, T& max, T& min) {
 	}
 }
 
+/**
+Worker threads shared by every ParallelForRows call. They are started once, on first use, and 
+sleep between jobs, so that callers such as the multigrid relaxation sweeps, which go through 
+ParallelForRows many times per image, do not pay for a thread start and join on each call.
+*/
+class RowWorkers {
+public:
+	RowWorkers() : _job(NULL), _bands(0), _pending(0), _generation(0), _stop(false) {
+		int n_threads = (int)std::thread::hardware_concurrency();
+		for(int t = 1; t < n_threads; t++) {
+			_threads.push_back(std::thread(&RowWorkers::Loop, this, t));
+		}
+	}
+
+	~RowWorkers() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for(size_t t = 0; t < _threads.size(); t++) {
+			_threads[t].join();
+		}
+	}
+
+	/// Number of threads a job can use, including the calling thread
+	int Size() const {
+		return (int)_threads.size() + 1;
+	}
+
+	/**
+	Runs band(t) for every t in [0, n_bands), band 0 on the calling thread, and returns when all 
+	bands are done. Only one job runs at a time: callers must hold Busy() while calling Run.
+	@param n_bands Number of bands, at most Size()
+	@param band Band function
+	*/
+	void Run(int n_bands, const std::function<void(int)>& band) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_job = &band;
+			_bands = n_bands;
+			_pending = n_bands - 1;
+			_generation++;
+		}
+		_wake.notify_all();
+		band(0);
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this]() { return _pending == 0; });
+		_job = NULL;
+	}
+
+	/// Held by the caller of Run for the whole job
+	std::mutex& Busy() {
+		return _busy;
+	}
+
+	/// The workers of the process, started on first use
+	static RowWorkers& Get() {
+		static RowWorkers workers;
+		return workers;
+	}
+
+private:
+	void Loop(int index) {
+		unsigned long seen = 0;
+		std::unique_lock<std::mutex> lock(_mutex);
+		for(;;) {
+			_wake.wait(lock, [&]() { return _stop || _generation != seen; });
+			if(_stop) {
+				return;
+			}
+			seen = _generation;
+			if(index >= _bands) {
+				continue;
+			}
+			const std::function<void(int)> *job = _job;
+			lock.unlock();
+			(*job)(index);
+			lock.lock();
+			if(--_pending == 0) {
+				_done.notify_one();
+			}
+		}
+	}
+
+	std::vector<std::thread> _threads;
+	std::mutex _busy;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+	const std::function<void(int)> *_job;
+	int _bands;
+	int _pending;
+	unsigned long _generation;
+	bool _stop;
+
+	RowWorkers(const RowWorkers&);
+	RowWorkers& operator=(const RowWorkers&);
+};
+
+/**
+Runs fn(row) for every row in [begin, end), splitting the range into one contiguous band per 
+hardware thread on the shared RowWorkers. Rows must be independent of each other. Ranges of less 
+than min_work pixels (rows * width) run on the calling thread, where waking the workers would cost 
+more than it saves, as do calls made while another ParallelForRows is running (including nested 
+calls from a row function).
+@param begin First row
+@param end One past the last row
+@param width Pixels per row, used to size the work
+@param fn Row function
+*/
+template <class ROW_FN>
+void ParallelForRows(int begin, int end, int width, ROW_FN fn) {
+	const long min_work = 1L << 16;
+	const long work = (long)(end - begin) * width;
+	if(work < min_work || std::thread::hardware_concurrency() <= 1) {
+		for(int row = begin; row < end; row++) {
+			fn(row);
+		}
+		return;
+	}
+
+	RowWorkers& workers = RowWorkers::Get();
+	std::unique_lock<std::mutex> busy(workers.Busy(), std::try_to_lock);
+	int n_threads = workers.Size();
+	if(n_threads > end - begin) n_threads = end - begin;
+	if(!busy.owns_lock() || n_threads <= 1) {
+		for(int row = begin; row < end; row++) {
+			fn(row);
+		}
+		return;
+	}
+
+	const int count = end - begin;
+	workers.Run(n_threads, [&](int t) {
+		const int first = begin + (int)((long)count * t / n_threads);
+		const int last = begin + (int)((long)count * (t + 1) / n_threads);
+		for(int row = first; row < last; row++) {
+			fn(row);
+		}
+	});
+}
+
 // ==========================================================
 //   Utility functions
 // ==========================================================
@@ -18,11 +18,16 @@
 #include "image-utils.h"
 #include "renderer.h"
 
+#include "animation.h"
 #include "async-tools.h"
+#include "film-file.h"
+#include "film.h"
+#include "sampler.h"
 #include "scene.h"
 
 #include <atomic>
-#include <random>
+#include <chrono>
+#include <stdexcept>
 
 struct RTWorkFlag {
   std::atomic<bool> is_raytracing;
@@ -32,10 +37,58 @@ struct RTWorkFlag {
 
 struct RTConfig {
   bool ss_antialias = false;
+  // subsamples per pixel per sample are supersample_factor^2
   int supersample_factor = 2;
+  sls::ReconstructionFilter filter = sls::ReconstructionFilter::tent();
   int width = 1920;
   int height = 1080;
 
+  // keys every random draw; equal seeds give bit-identical renders
+  uint64_t seed = 0;
+
+  sls::Integrator integrator = sls::IntegratorWhitted;
+  sls::PathConfig path;
+
+  // write the progressive image every n samples (and always at the end)
+  int output_interval = 1;
+  // progressive images go here instead of the output file when set; an .hdr
+  // checkpoint is cheap to encode and keeps the full range
+  std::string checkpoint_file;
+
+  // float output settings, used when out_file_name is an .exr
+  ExrOptions exr;
+  // PNG encoder effort: progressive images favour speed, the last one size
+  PngOptions checkpoint_png = PngOptions::fast();
+  PngOptions final_png = PngOptions::small();
+  // radiance is unclamped; 8-bit images are tone mapped once when written
+  ToneMapOptions tone;
+  // tone mapped preview of the final image, max_size pixels on its long side;
+  // sequences write one per frame, strip renders none
+  std::string thumbnail_file;
+  int thumbnail_size = 256;
+
+  // keep the film in this memory-mapped file (whole-frame renders only);
+  // resume continues a matching file where it stopped
+  std::string film_file;
+  bool resume = false;
+  // the film file is synced to disk every n samples, a blocking write of the
+  // whole film; progressive images in between only start its write-back
+  int checkpoint_interval = 16;
+
+  // > 0: render and encode this many rows at a time (PNG/EXR only) instead
+  // of keeping the whole film. Strips take every sample in one pass, so only
+  // the sample cap applies; 8-bit strips are quantized (--dither,
+  // --linear-output) but not tone mapped
+  int strip_rows = 0;
+
+  // termination: the sample cap passed to rayTrace always applies; a
+  // value <= 0 disables the other policies. Whichever is hit first stops
+  // the render
+  double time_budget_seconds = 0.0;
+  double target_rmse = 0.0;
+  // samples taken before the noise estimate is trusted
+  size_t min_noise_samples = 4;
+
   bool use_window_size = false;
 };
 
@@ -44,17 +97,22 @@ static GLFWwindow *WINDOW;
 void setup_scene(vec4 const &material_diffuse, vec4 const &material_ambient,
                  vec4 const &material_specular);
 
-vec4 castRay(vec4 p0, vec4 dir, size_t depth, size_t max_depth = 10,
-             std::shared_ptr<sls::SceneObject> obj = nullptr);
+vec4 castRay(vec4 p0, vec4 dir, sls::Sampler &sampler, size_t depth,
+             size_t max_depth = 10,
+             std::shared_ptr<sls::SceneObject> obj = nullptr,
+             vec4 const &throughput = vec4(1.0));
 
 void bind_viewport(int pInt[4]);
 
 std::vector<std::vector<sls::rt_data>> get_rt_work(int width, int height,
                                                    int n_threads);
 
-vec4 castRay(sls::Ray const &ray, size_t depth, size_t max_depth = 10,
-             std::shared_ptr<sls::SceneObject> obj = nullptr) {
-  return castRay(ray.start, ray.dir, depth, max_depth, obj);
+vec4 castRay(sls::Ray const &ray, sls::Sampler &sampler, size_t depth,
+             size_t max_depth = 10,
+             std::shared_ptr<sls::SceneObject> obj = nullptr,
+             vec4 const &throughput = vec4(1.0)) {
+  return castRay(ray.start, ray.dir, sampler, depth, max_depth, obj,
+                 throughput);
 }
 
 //---------------------------------type
@@ -75,6 +133,7 @@ int window_width, window_height;
 
 bool render_line;
 Mesh sphere_mesh;
+Mesh quad_mesh;
 
 GLuint vPosition, vNormal, vTexCoord;
 
@@ -87,6 +146,8 @@ mat4 projection;
 mat4 model_view;
 
 static auto scene = sls::Scene();
+static auto path_config = sls::PathConfig();
+static sls::RayStats ray_stats;
 
 struct LightUnifs {
   GLuint diffuse_prods;
@@ -122,7 +183,8 @@ RTWorkFlag rt_flags;
 
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
-sls::Ray findRay(GLdouble x, GLdouble y, int width, int height) {
+void unprojectPixel(GLdouble x, GLdouble y, int width, int height,
+                    vec4 &near_point, vec4 &far_point) {
   static std::mutex locker;
 
   y = height - y;
@@ -158,17 +220,38 @@ sls::Ray findRay(GLdouble x, GLdouble y, int width, int height) {
                &farPlaneLocation[0], &farPlaneLocation[1],
                &farPlaneLocation[2]);
 
-  vec4 ray_origin = vec4(nearPlaneLocation[0], nearPlaneLocation[1],
-                         nearPlaneLocation[2], 1.0);
-  vec3 temp = vec3(farPlaneLocation[0] - nearPlaneLocation[0],
-                   farPlaneLocation[1] - nearPlaneLocation[1],
-                   farPlaneLocation[2] - nearPlaneLocation[2]);
-  temp = normalize(temp);
+  near_point = vec4(nearPlaneLocation[0], nearPlaneLocation[1],
+                    nearPlaneLocation[2], 1.0);
+  far_point = vec4(farPlaneLocation[0], farPlaneLocation[1],
+                   farPlaneLocation[2], 1.0);
+}
+
+sls::Ray findRay(GLdouble x, GLdouble y, int width, int height) {
+  vec4 ray_origin, far_point;
+  unprojectPixel(x, y, width, height, ray_origin, far_point);
+
+  vec3 temp = normalize(sls::xyz(far_point - ray_origin));
   vec4 ray_dir = vec4(temp.x, temp.y, temp.z, 0.0);
 
   return sls::Ray(ray_origin, ray_dir);
 }
 
+sls::PixelCamera findCamera(int width, int height) {
+  auto cam = sls::PixelCamera();
+  vec4 near_x, far_x, near_y, far_y;
+
+  unprojectPixel(0.0, 0.0, width, height, cam.near_origin, cam.far_origin);
+  unprojectPixel(1.0, 0.0, width, height, near_x, far_x);
+  unprojectPixel(0.0, 1.0, width, height, near_y, far_y);
+
+  cam.near_dx = near_x - cam.near_origin;
+  cam.near_dy = near_y - cam.near_origin;
+  cam.far_dx = far_x - cam.far_origin;
+  cam.far_dy = far_y - cam.far_origin;
+
+  return cam;
+}
+
 /**
  * used to querry GL_VIEWPORT from multiple threads
  */
@@ -195,7 +278,8 @@ void castRayDebug(vec4 p0, vec4 dir) {
     double t = i->intersect_t(sls::Ray{p0, dir});
 
     if (t > 0) {
-      auto color = castRay(p0, dir, 0, 3, nullptr);
+      auto sampler = sls::Sampler(0, 0, 0);
+      auto color = castRay(p0, dir, sampler, 0, 3, nullptr);
       vec4 temp = p0 + t * dir;
       vec3 temp_3 = vec3(temp.x, temp.y, temp.z);
       std::cout << p0 + t * dir << "\t\t" << length(temp_3) << "\n"
@@ -206,8 +290,10 @@ void castRayDebug(vec4 p0, vec4 dir) {
 
 /* -------------------------------------------------------------------------- */
 
-vec4 castRay(vec4 p0, vec4 dir, size_t depth, size_t max_depth,
-             std::shared_ptr<sls::SceneObject> current_object) {
+vec4 castRay(vec4 p0, vec4 dir, sls::Sampler &sampler, size_t depth,
+             size_t max_depth,
+             std::shared_ptr<sls::SceneObject> current_object,
+             vec4 const &throughput) {
 
   // castRayDebug(p0, dir);
 
@@ -222,37 +308,10 @@ vec4 castRay(vec4 p0, vec4 dir, size_t depth, size_t max_depth,
   if (depth > max_depth) {
     return clear_color;
   }
+  ray_stats.traced.fetch_add(1, memory_order_relaxed);
 
-  double z_depth = NAN;
-  struct obj_hit_t {
-    shared_ptr<SceneObject> obj;
-    Intersection inter;
-    vec4 hit_point;
-  };
-
-  auto hit_found = false;
-  auto nearest_hit = obj_hit_t();
-
-  // iterate one time to get maximum depth
-  // for ray
-  for (auto obj : scene.objects) {
-    if ((obj->target & sls::TargetRayTracer) != sls::TargetRayTracer) {
-      continue;
-    }
-    auto intersection = obj->intersect(ray_viewspace);
-    auto hit_point = p0 + intersection.t * dir;
-    if (intersection.t >= 0) {
-
-      auto hit = obj_hit_t{obj, intersection, hit_point};
-
-      if (!hit_found) {
-        hit_found = true;
-        nearest_hit = hit;
-      } else if (intersection.t < nearest_hit.inter.t) {
-        nearest_hit = hit;
-      }
-    }
-  }
+  auto nearest_hit = SceneHit();
+  auto hit_found = find_nearest_hit(scene, ray_viewspace, nearest_hit);
 
   if (hit_found) {
 
@@ -263,7 +322,7 @@ vec4 castRay(vec4 p0, vec4 dir, size_t depth, size_t max_depth,
     auto normal = normalize(intersection.normal);
     auto obj_name = obj->name;
 
-    auto hit_viewspace = nearest_hit.hit_point;
+    auto hit_viewspace = nearest_hit.point;
 
     auto reflection = vec4(0.0, 0.0, 0.0, 0.0);
     auto transmitted = vec4(0.0, 0.0, 0.0, 0.0);
@@ -271,12 +330,27 @@ vec4 castRay(vec4 p0, vec4 dir, size_t depth, size_t max_depth,
     auto const &mtl = obj->material;
     if (mtl.k_reflective > 0.0 ||
         mtl.k_specular > 0.0) { // non-zero reflectivity
-      auto reflect_dir = normalize(-reflect(dir, normalize(vec4(normal, 0.0))));
-      reflection =
-          castRay(hit_viewspace, reflect_dir, depth + 1, max_depth, obj);
+      auto weight = throughput * reflection_weight(mtl, scene.n_lights());
+      auto survival =
+          branch_survival(weight, depth + 1, path_config, sampler, ray_stats);
+
+      if (survival > 0.0) {
+        auto reflect_dir =
+            normalize(-reflect(dir, normalize(vec4(normal, 0.0))));
+        reflection = castRay(hit_viewspace, reflect_dir, sampler, depth + 1,
+                             max_depth, obj, weight / survival) /
+                     survival;
+      }
     }
 
-    if (mtl.k_transmittance > 1e-7) { // non-zero transmittance
+    auto transmit_weight = throughput * transmission_weight(mtl);
+    auto transmit_survival = 0.0f;
+    if (mtl.k_transmittance > 1e-7) {
+      transmit_survival = branch_survival(transmit_weight, depth + 1,
+                                          path_config, sampler, ray_stats);
+    }
+
+    if (transmit_survival > 0.0) { // non-zero transmittance
       auto inside_obj = dot(dir, normal) < 0;
       auto outer_ior =
           inside_obj ? scene.space_k_refraction : obj->material.k_refraction;
@@ -287,19 +361,293 @@ vec4 castRay(vec4 p0, vec4 dir, size_t depth, size_t max_depth,
                                                normal, inner_ior / outer_ior);
       // move refraction ray a bit foreward
       refraction_ray.start += refraction_ray.dir / 1000.0;
-      transmitted = castRay(refraction_ray, depth + 1, max_depth, obj);
+      transmitted = castRay(refraction_ray, sampler, depth + 1, max_depth, obj,
+                            transmit_weight / transmit_survival) /
+                    transmit_survival;
     }
 
     color += sls::shade_ray_intersection(scene, obj, hit_viewspace, normal,
-                                         reflection, transmitted);
+                                         reflection, transmitted, sampler);
   }
 
-  return sls::clamp(color, 0.0, 1.0);
+  // unclamped: radiance stays linear until the film is resolved
+  return color;
 }
 
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
 
+/**
+ * @brief one sample's estimate for pixel (x, y): the ray through the pixel
+ * center, or stratified jittered subsamples weighted by the reconstruction
+ * filter
+ */
+vec4 render_pixel(size_t x, size_t y, sls::Ray const &center, size_t sample,
+                  RTConfig const &cf, sls::PixelCamera const &camera,
+                  int width) {
+  using namespace sls;
+  auto const max_rt_depth = 6;
+  auto const ss_factor = cf.ss_antialias ? std::max(cf.supersample_factor, 1)
+                                         : 1;
+  auto const n_subsamples = ss_factor * ss_factor;
+  auto const &filter = cf.filter;
+
+  // each worker draws its own light samples for this pixel
+  auto sampler = Sampler(cf.seed, y * width + x, sample);
+
+  auto radiance = [&](Ray const &ray) {
+    if (cf.integrator == IntegratorPath) {
+      return trace_path(scene, ray, sampler, path_config, ray_stats);
+    }
+    return castRay(ray, sampler, 0, max_rt_depth, nullptr);
+  };
+
+  if (n_subsamples == 1) {
+    return radiance(center);
+  }
+
+  // jittered subsamples are filtered into the pixel as they are traced;
+  // every ray contributes
+  auto acc = vec4(0.0, 0.0, 0.0, 0.0);
+  auto weight_sum = 0.0f;
+  for (auto k = 0; k < n_subsamples; ++k) {
+    auto offset = filter.stratified_offset(k, ss_factor, sampler.next_2d());
+    auto weight = filter.weight(offset);
+    if (weight <= 0.0f) {
+      continue;
+    }
+
+    auto ray = camera.ray(x + offset.x, y + offset.y);
+    acc += weight * radiance(ray);
+    weight_sum += weight;
+  }
+
+  return weight_sum > 0.0f ? acc / weight_sum : acc;
+}
+
+/**
+ * @brief renders cf.strip_rows rows at a time with every sample, then hands
+ * the strip to a streaming encoder and reuses its memory, so neither the
+ * film nor the image is ever held for the whole frame.
+ * @param rmse set to the noise estimate over all strips
+ * @return false if the output can't be opened or written; check
+ * is_streamable first, since other formats need the whole film
+ */
+bool render_strips(size_t max_samples, RTConfig const &cf, int width,
+                   int height, int n_threads, double &rmse) {
+  using namespace std;
+  using namespace sls;
+
+  auto writer = open_scanline_writer(out_file_name, width, height, cf.exr,
+                                     cf.final_png, cf.tone.quantize);
+  if (!writer) {
+    cerr << "could not open " << out_file_name << " for streaming\n";
+    return false;
+  }
+
+  auto const camera = findCamera(width, height);
+  auto const strip_rows = min(cf.strip_rows, height);
+  auto strip = FilmAccumulator(width, strip_rows);
+  auto rows = vector<float>();
+  auto tasks = vector<future<void>>();
+  auto mean_square_error = 0.0;
+
+  cout << "streaming " << strip_rows << " rows at a time\n";
+
+  for (auto row0 = 0; row0 < height; row0 += strip_rows) {
+    auto const n_rows = min(strip_rows, height - row0);
+    auto const n_pixels = size_t(n_rows) * width;
+
+    strip.clear();
+
+    // once quit is signalled, the remaining strips are written black so the
+    // file stays valid
+    if (!rt_flags.signal_quit_raytracing) {
+      auto const step = (n_pixels + n_threads - 1) / n_threads;
+      for (auto begin = size_t(0); begin < n_pixels; begin += step) {
+        auto const end = min(begin + step, n_pixels);
+        tasks.push_back(async(launch::async, [&, begin, end]() {
+          for (auto idx = begin; idx < end; ++idx) {
+            auto const x = idx % width;
+            auto const y = row0 + idx / width;
+            for (auto sample = 0lu; sample < max_samples; ++sample) {
+              strip.add(idx, render_pixel(x, y, camera.ray(x, y), sample, cf,
+                                          camera, width));
+            }
+          }
+        }));
+      }
+      for (auto &task : tasks) {
+        task.get();
+      }
+      tasks.clear();
+
+      if (max_samples > 1) {
+        auto const strip_rmse = strip.estimated_rmse();
+        mean_square_error += strip_rmse * strip_rmse * n_rows / height;
+      }
+    }
+
+    strip.resolve_rgba32f(rows);
+    if (!writer->write_rows(&rows[0], n_rows)) {
+      break;
+    }
+  }
+
+  rt_flags.signal_quit_raytracing = false;
+  rmse = max_samples > 1 ? std::sqrt(mean_square_error) : INFINITY;
+  return writer->close();
+}
+
+/**
+ * @brief writes the film: float formats (EXR, HDR) get the linear
+ * accumulator directly, everything else is tone mapped to 8 bits
+ */
+void write_film(sls::FilmAccumulator const &film, RTConfig const &cf,
+                std::string const &filename, PngOptions const &png,
+                std::vector<uint8_t> &buffer, std::vector<float> &hdr_buffer) {
+  if (is_float_image(filename)) {
+    film.resolve_rgba32f(hdr_buffer);
+    write_image(filename, &hdr_buffer[0], film.width, film.height, 4, cf.exr);
+  } else {
+    film.resolve_rgba32f(hdr_buffer);
+    tone_map(&hdr_buffer[0], film.width, film.height, cf.tone, buffer);
+    write_image(filename, &buffer[0], film.width, film.height, 4, png);
+  }
+}
+
+/**
+ * @brief parses named[name] with parse (a std::sto* wrapper) into value
+ * @detail Text that isn't entirely a number, is out of range or, when
+ * positive is set, isn't greater than zero is reported and leaves value at
+ * its default, so a typo in a flag never takes the program down.
+ */
+template <typename T, typename PARSE_T>
+void parse_number(std::map<std::string, std::string> const &named,
+                  std::string const &name, PARSE_T parse, bool positive,
+                  T &value) {
+  if (!named.count(name)) {
+    return;
+  }
+  auto const &text = named.at(name);
+  try {
+    auto used = size_t(0);
+    auto const parsed = parse(text, &used);
+    if (used != text.size()) {
+      throw std::invalid_argument(name);
+    }
+    if (positive && !(parsed > 0)) {
+      std::cerr << "--" << name << "=" << text
+                << " must be greater than zero, keeping " << value << "\n";
+      return;
+    }
+    value = T(parsed);
+  } catch (std::invalid_argument const &) {
+    std::cerr << "--" << name << "=" << text << " is not a number, keeping "
+              << value << "\n";
+  } catch (std::out_of_range const &) {
+    std::cerr << "--" << name << "=" << text << " is out of range, keeping "
+              << value << "\n";
+  }
+}
+
+/**
+ * @brief render settings from --samples=, --time= (seconds), --rmse=,
+ * --checkpoint= (file), --png= and --png-checkpoint= (fast|small|default),
+ * --film= (file), --resume, --checkpoint-interval= (samples), --strip=
+ * (rows), --exr-float, --exr-compression=zip|piz|pxr24|b44|none,
+ * --tonemap=clamp|filmic|reinhard|drago|fattal, --exposure= (stops),
+ * --dither, --linear-output, --thumbnail= (file) and --thumbnail-size=
+ * (pixels)
+ */
+RTConfig config_from_args(sls::CommandLineArgs const &args,
+                          size_t &max_samples) {
+  auto cf = RTConfig();
+  auto const &named = args.named_args;
+
+  auto const as_long = [](std::string const &text, size_t *used) {
+    return std::stol(text, used);
+  };
+  auto const as_int = [](std::string const &text, size_t *used) {
+    return std::stoi(text, used);
+  };
+  auto const as_double = [](std::string const &text, size_t *used) {
+    return std::stod(text, used);
+  };
+  auto const as_float = [](std::string const &text, size_t *used) {
+    return std::stof(text, used);
+  };
+
+  parse_number(named, "samples", as_long, true, max_samples);
+  parse_number(named, "time", as_double, true, cf.time_budget_seconds);
+  parse_number(named, "rmse", as_double, true, cf.target_rmse);
+  if (named.count("checkpoint")) {
+    cf.checkpoint_file = named.at("checkpoint");
+  }
+  auto png_profile = [&](std::string const &name, PngOptions &png) {
+    if (!named.count(name)) {
+      return;
+    }
+    auto const &profile = named.at(name);
+    if (profile == "fast") {
+      png = PngOptions::fast();
+    } else if (profile == "small") {
+      png = PngOptions::small();
+    } else {
+      png = PngOptions();
+    }
+  };
+  png_profile("png", cf.final_png);
+  png_profile("png-checkpoint", cf.checkpoint_png);
+  if (named.count("film")) {
+    cf.film_file = named.at("film");
+  }
+  cf.resume = named.count("resume") > 0;
+  parse_number(named, "checkpoint-interval", as_int, true,
+               cf.checkpoint_interval);
+  parse_number(named, "strip", as_int, true, cf.strip_rows);
+  if (named.count("exr-float")) {
+    cf.exr.half_float = false;
+  }
+  if (named.count("exr-compression")) {
+    static const std::map<std::string, ExrCompression> by_name = {
+        {"zip", ExrZip},
+        {"piz", ExrPiz},
+        {"pxr24", ExrPxr24},
+        {"b44", ExrB44},
+        {"none", ExrNone}};
+    auto it = by_name.find(named.at("exr-compression"));
+    if (it != by_name.end()) {
+      cf.exr.compression = it->second;
+    } else {
+      std::cerr << "unknown exr compression, using zip\n";
+    }
+  }
+  if (named.count("tonemap")) {
+    static const std::map<std::string, ToneOperator> by_name = {
+        {"clamp", ToneClamp},
+        {"filmic", ToneFilmic},
+        {"reinhard", ToneReinhard05},
+        {"drago", ToneDrago03},
+        {"fattal", ToneFattal02}};
+    auto it = by_name.find(named.at("tonemap"));
+    if (it != by_name.end()) {
+      cf.tone.op = it->second;
+    } else {
+      std::cerr << "unknown tone mapping, clamping\n";
+    }
+  }
+  parse_number(named, "exposure", as_float, false, cf.tone.exposure);
+  cf.tone.drago_exposure = cf.tone.exposure;
+  cf.tone.quantize.dither = named.count("dither") > 0;
+  cf.tone.quantize.srgb = named.count("linear-output") == 0;
+  if (named.count("thumbnail")) {
+    cf.thumbnail_file = named.at("thumbnail");
+  }
+  parse_number(named, "thumbnail-size", as_int, true, cf.thumbnail_size);
+  return cf;
+}
+
 /**
  * @brief Performs the ray tracing algorithm.
  * @detail allows multiple sampling for diffuse path tracing or
@@ -319,56 +667,100 @@ void rayTrace(size_t max_samples = 1, RTConfig cf = RTConfig()) {
   }
 
   auto ss_factor = cf.ss_antialias ? max(cf.supersample_factor, 1) : 1;
-  auto supersample_width = width * ss_factor;
-  auto supersample_height = height * ss_factor;
+  auto const n_subsamples = ss_factor * ss_factor;
 
   assert(ss_factor > 0);
 
-  cout << "rendering supersamples " << supersample_width << " * "
-       << supersample_height << "\n";
-
-  auto buffer = vector<uint8_t>(width * height * 4);
-
-  auto supersamples = vector<color4>(supersample_width * supersample_height);
-  auto color_buffer = vector<color4>(width * height);
-
-  using loop_pair_t = pair<size_t, vector<vec4>>;
+  cout << "rendering " << width << " * " << height << " with "
+       << n_subsamples << " subsamples per pixel\n";
 
   // params
   auto const n_threads = 20;
-  auto const max_rt_depth = 6;
 
-  auto work_units =
-      get_rt_work(supersample_width, supersample_height, n_threads);
+  path_config = cf.path;
+  ray_stats.reset();
 
-  auto results = vector<future<vector<rt_data>>>();
+  using clock = chrono::steady_clock;
+  auto const t_start = clock::now();
+  auto elapsed_seconds = [&]() {
+    return chrono::duration<double>(clock::now() - t_start).count();
+  };
+  auto rmse = double(INFINITY);
+
+  auto report = [&](size_t n_samples) {
+    cout << "\ntraced " << n_samples
+         << ((n_samples > 1) ? " samples.\n" : " sample.\n");
+    cout << "elapsed: " << elapsed_seconds() << "s, estimated rmse: " << rmse
+         << "\n";
+    cout << "rays traced: " << ray_stats.traced
+         << ", culled: " << ray_stats.culled
+         << ", ended by roulette: " << ray_stats.roulette << "\n";
+  };
 
-  using namespace std;
-  auto rng = default_random_engine(random_device()());
+  // an output that can't be opened aborts: falling back to the whole film
+  // would break the memory bound --strip promises
+  if (cf.strip_rows > 0 && is_streamable(out_file_name)) {
+    if (!cf.thumbnail_file.empty()) {
+      cerr << "--thumbnail needs the whole image, so it isn't written with "
+              "--strip\n";
+    }
+    if (render_strips(max_samples, cf, width, height, n_threads, rmse)) {
+      report(max_samples);
+    } else {
+      cerr << "streaming render failed\n";
+    }
+    rt_flags.is_raytracing = false;
+    return;
+  }
+  if (cf.strip_rows > 0) {
+    cout << "output format can't be streamed, keeping the whole film\n";
+  }
 
-  auto sample = 0;
-  for (sample = 0; sample < max_samples; ++sample) {
-    if (rt_flags.signal_quit_raytracing) {
-      rt_flags.signal_quit_raytracing = false;
-      break;
+  auto buffer = vector<uint8_t>();
+  auto hdr_buffer = vector<float>();
+
+  // the film lives in a mapped file when the render should survive a crash
+  auto film_file = unique_ptr<FilmFile>();
+  auto owned_film = unique_ptr<FilmAccumulator>();
+  if (!cf.film_file.empty()) {
+    film_file = FilmFile::open(cf.film_file, width, height,
+                               uint32_t(n_subsamples), uint32_t(cf.integrator),
+                               cf.seed, cf.resume);
+    if (!film_file) {
+      cout << "film file unavailable, rendering in memory\n";
     }
+  }
+  if (!film_file) {
+    owned_film.reset(new FilmAccumulator(width, height));
+  }
+  auto &film = film_file ? film_file->film() : *owned_film;
+  auto const first_sample = film_file ? int(film_file->samples_done()) : 0;
+  if (first_sample > 0) {
+    cout << "resuming at sample " << first_sample << "\n";
+  }
+
+  auto const output_interval = max(cf.output_interval, 1);
+  auto const checkpoint_interval = max(cf.checkpoint_interval, 1);
+  auto const &checkpoint_file =
+      cf.checkpoint_file.empty() ? out_file_name : cf.checkpoint_file;
 
-    auto light_locs = scene.light_locations;
-    auto std_dev = 0.1;
+  auto work_units = get_rt_work(width, height, n_threads);
+  auto const camera = findCamera(width, height);
 
-    for (auto &l : scene.light_locations) {
-      auto dist_x = normal_distribution<float>(l.x, std_dev);
-      auto dist_y = normal_distribution<float>(l.y, std_dev);
-      auto dist_z = normal_distribution<float>(l.z, std_dev);
+  auto results = vector<future<vector<rt_data>>>();
 
-      l = vec4(dist_x(rng), dist_y(rng), dist_z(rng), l.w);
+  auto sample = first_sample;
+  for (; sample < max_samples; ++sample) {
+    if (rt_flags.signal_quit_raytracing) {
+      rt_flags.signal_quit_raytracing = false;
+      break;
     }
 
     for (auto &unit : work_units) {
       results.push_back(raycast_async(
           [&](auto &i) {
-            i.color =
-                castRay(i.rays.start, i.rays.dir, 0, max_rt_depth, nullptr);
+            i.color = render_pixel(i.i, i.j, i.rays, size_t(sample), cf,
+                                   camera, width);
             return i;
           },
           unit));
@@ -377,81 +769,244 @@ void rayTrace(size_t max_samples = 1, RTConfig cf = RTConfig()) {
     for (auto &fut : results) {
       auto unit = fut.get();
       for (auto const &data : unit) {
+        // a resumed pass skips pixels that got this sample before a crash
+        auto const idx = data.j * width + data.i;
+        if (film.count[idx] <= uint32_t(sample)) {
+          film.add(idx, data.color);
+        }
+      }
+    }
+    results.clear();
 
-        auto idx = data.j * supersample_width + data.i;
-        supersamples[idx] = data.color;
+    if (film_file) {
+      if ((sample + 1) % checkpoint_interval == 0) {
+        film_file->checkpoint(uint32_t(sample + 1));
+      } else if ((sample + 1) % output_interval == 0) {
+        film_file->flush();
       }
-      for (auto j = 0; j < height; ++j) {
-        for (auto i = 0; i < width; ++i) {
+    }
+    if ((sample + 1) % output_interval == 0) {
+      write_film(film, cf, checkpoint_file, cf.checkpoint_png, buffer,
+                 hdr_buffer);
+    }
 
-          auto idx = j * width + i;
-          auto const n_subpixels = ss_factor * 4;
+    auto const n_traced = size_t(sample + 1 - first_sample);
+    if (cf.target_rmse > 0.0 && size_t(sample + 1) >= cf.min_noise_samples) {
+      rmse = film.estimated_rmse();
+      if (rmse <= cf.target_rmse) {
+        cout << "noise target reached\n";
+        ++sample;
+        break;
+      }
+    }
 
-          // calculate range to take subpixels
-          auto dist = poisson_distribution<int>(ss_factor / 2);
+    // stop if the next sample would likely overrun the time budget
+    if (cf.time_budget_seconds > 0.0) {
+      auto const elapsed = elapsed_seconds();
+      auto const per_sample = elapsed / n_traced;
+      if (elapsed + per_sample > cf.time_budget_seconds) {
+        cout << "time budget reached\n";
+        ++sample;
+        break;
+      }
+    }
+  }
 
-          auto ss_j_min = j * ss_factor;
-          auto ss_j_max = ss_j_min + ss_factor;
+  if (film_file) {
+    film_file->checkpoint(uint32_t(sample));
+  }
 
-          auto ss_i_min = i * ss_factor;
-          auto ss_i_max = ss_i_min + ss_factor;
+  // the final image always goes to out_file_name, with the final profile
+  if (sample > 0) {
+    write_film(film, cf, out_file_name, cf.final_png, buffer, hdr_buffer);
+    if (!cf.thumbnail_file.empty()) {
+      write_thumbnail(cf.thumbnail_file, &hdr_buffer[0], width, height,
+                      cf.thumbnail_size, cf.tone);
+    }
+  }
 
-          color4 acc = vec4(0.0, 0.0, 0.0, 0.0);
+  if (sample > 1) {
+    rmse = film.estimated_rmse();
+  }
+  report(size_t(sample));
+  rt_flags.is_raytracing = false;
+}
 
-          if (ss_factor > 1) {
+/**
+ * @brief output name for a sequence frame: a run of '#' in the pattern
+ * becomes the zero-padded frame number, otherwise _NNNN goes before the
+ * extension
+ */
+std::string frame_file_name(std::string const &pattern, int frame) {
+  using namespace std;
+  auto pad = [frame](size_t width) {
+    auto number = to_string(frame);
+    if (number.size() < width) {
+      number.insert(0, width - number.size(), '0');
+    }
+    return number;
+  };
+
+  auto const first = pattern.find('#');
+  if (first != string::npos) {
+    auto last = pattern.find_first_not_of('#', first);
+    last = last == string::npos ? pattern.size() : last;
+    return pattern.substr(0, first) + pad(last - first) + pattern.substr(last);
+  }
 
-            for (auto k = 0; k < n_subpixels; ++k) {
-              // poisson ss_aa
+  auto dot = pattern.rfind('.');
+  auto const slash = pattern.find_last_of("/\\");
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    dot = pattern.size();
+  }
+  return pattern.substr(0, dot) + "_" + pad(4) + pattern.substr(dot);
+}
 
-              auto sample_i = clamp(dist(rng), 0, ss_factor - 1);
-              auto sample_j = clamp(dist(rng), 0, ss_factor - 1);
+/**
+ * @brief renders frames 0..n of a keyframe path, each with every sample.
+ * @detail Keys move the camera and the scene objects in place; the objects,
+ * film, worker threads and image buffers are set up once and reused, so a
+ * frame costs only its own tracing. Each finished frame is encoded on a
+ * background task while the next one traces, with at most one encode in
+ * flight. A .tif output without '#' collects the frames as the pages of one
+ * file; anything else gets a numbered file per frame. A --thumbnail= name is
+ * numbered the same way, one thumbnail per frame.
+ * @return false if any frame failed to encode or write
+ */
+bool renderSequence(size_t max_samples, RTConfig const &cf,
+                    sls::KeyframePath const &path) {
+  using namespace std;
+  using namespace sls;
+  rt_flags.is_raytracing = true;
 
-              auto ii = ss_i_min + sample_i;
-              auto jj = ss_j_min + sample_j;
+  auto const width = cf.width;
+  auto const height = cf.height;
+  path_config = cf.path;
+  ray_stats.reset();
 
-              auto ss_idx = jj * supersample_width + ii;
+  auto pages = unique_ptr<PageWriter>();
+  if (out_file_name.find('#') == string::npos) {
+    pages = open_multipage_writer(out_file_name);
+  }
 
-              acc += supersamples[ss_idx];
-            }
+  // keys are relative to the scene as it was set up
+  auto base_modelviews = vector<mat4>();
+  for (auto const &obj : scene.objects) {
+    base_modelviews.push_back(obj->modelview());
+  }
 
-            acc /= float(n_subpixels);
+  WorkerPool pool;
+  auto film = FilmAccumulator(width, height);
+  auto const tile_rows = 8;
+  auto const n_tiles = size_t(height + tile_rows - 1) / tile_rows;
 
-          } else if (ss_factor == 1) {
-            acc = supersamples[j * supersample_width + i];
-          }
+  // frame k resolves into one slot while frame k - 1 encodes from the other
+  vector<float> hdr_buffers[2];
+  vector<uint8_t> buffers[2];
+  auto encoding = future<bool>();
 
-          auto buff = &buffer[idx * 4];
-          auto const &color = acc;
+  cout << "rendering " << path.n_frames() << " frames of " << width << " * "
+       << height << " on " << pool.size() << " threads\n";
 
-          // get weighted average of samples
-          if (sample > 0) {
-            auto sum_color = (color_buffer[idx] * float(sample) + color);
-            auto mean_color = sum_color / float(sample + 1);
-            color_buffer[idx] = mean_color;
+  using clock = chrono::steady_clock;
+  auto const t_start = clock::now();
+  auto n_frames = 0;
+  auto n_failed = 0;
 
-          } else {
-            color_buffer[idx] = color;
+  for (auto frame = 0; frame < path.n_frames(); ++frame) {
+    if (rt_flags.signal_quit_raytracing) {
+      rt_flags.signal_quit_raytracing = false;
+      break;
+    }
+    auto const t_frame = clock::now();
+
+    model_view = path.camera(frame).modelview();
+    scene.camera_modelview = model_view;
+    for (auto i = 0lu; i < scene.objects.size(); ++i) {
+      auto key = ObjectKey();
+      if (path.object(scene.objects[i]->name, frame, key)) {
+        scene.objects[i]->set_modelview(key.modelview(base_modelviews[i]));
+      }
+    }
+    auto const camera = findCamera(width, height);
+
+    film.clear();
+    pool.run(n_tiles, [&](size_t tile) {
+      auto const y1 = min(int(tile + 1) * tile_rows, height);
+      for (auto y = int(tile) * tile_rows; y < y1; ++y) {
+        for (auto x = 0; x < width; ++x) {
+          auto const idx = size_t(y) * width + x;
+          for (auto sample = 0lu; sample < max_samples; ++sample) {
+            film.add(idx, render_pixel(x, y, camera.ray(x, y), sample, cf,
+                                       camera, width));
           }
+        }
+      }
+    });
 
-          auto &color_to_write = color_buffer[idx];
+    auto const slot = frame % 2;
+    film.resolve_rgba32f(hdr_buffers[slot]);
+
+    // pages must be appended in order
+    if (encoding.valid() && !encoding.get()) {
+      ++n_failed;
+    }
+    encoding = async(launch::async, [&, frame, slot]() {
+      auto const &hdr = hdr_buffers[slot];
+      auto &buffer = buffers[slot];
+      auto const encode = [&]() {
+        if (pages) {
+          tone_map(&hdr[0], width, height, cf.tone, buffer);
+          return pages->append(&buffer[0], width, height);
+        }
 
-          buff[0] = static_cast<uint8_t>((color_to_write.x) * 255);
-          buff[1] = static_cast<uint8_t>((color_to_write.y) * 255);
-          buff[2] = static_cast<uint8_t>((color_to_write.z) * 255);
-          buff[3] = static_cast<uint8_t>((color_to_write.w) * 255);
+        auto const filename = frame_file_name(out_file_name, frame);
+        if (is_float_image(filename)) {
+          return write_image(filename, &hdr[0], width, height, 4, cf.exr);
         }
+        tone_map(&hdr[0], width, height, cf.tone, buffer);
+        return write_image(filename, &buffer[0], width, height, 4,
+                           cf.final_png);
+      };
+
+      auto ok = encode();
+      if (!cf.thumbnail_file.empty()) {
+        ok = write_thumbnail(frame_file_name(cf.thumbnail_file, frame),
+                             &hdr[0], width, height, cf.thumbnail_size,
+                             cf.tone) &&
+             ok;
       }
-    }
+      return ok;
+    });
 
-    write_image(out_file_name, &buffer[0], width, height, 4);
-    results.clear();
+    ++n_frames;
+    cout << "frame " << frame << " traced in "
+         << chrono::duration<double>(clock::now() - t_frame).count() << "s\n";
+  }
+
+  if (encoding.valid() && !encoding.get()) {
+    ++n_failed;
+  }
+  // every page is lost if the multipage file can't be written
+  if (pages && !pages->close()) {
+    n_failed = n_frames;
+  }
 
-    scene.light_locations = light_locs;
+  for (auto i = 0lu; i < scene.objects.size(); ++i) {
+    scene.objects[i]->set_modelview(base_modelviews[i]);
   }
 
-  cout << "\ntraced " << sample
-       << ((sample > 1) ? " samples.\n" : " sample.\n");
+  auto const elapsed = chrono::duration<double>(clock::now() - t_start).count();
+  cout << "\nrendered " << n_frames << " frames in " << elapsed << "s ("
+       << (n_frames > 0 ? elapsed / n_frames : 0.0) << "s per frame)\n";
+  cout << "rays traced: " << ray_stats.traced
+       << ", culled: " << ray_stats.culled
+       << ", ended by roulette: " << ray_stats.roulette << "\n";
+  if (n_failed > 0) {
+    cerr << n_failed << " of " << n_frames << " frames failed to write\n";
+  }
   rt_flags.is_raytracing = false;
+  return n_failed == 0;
 }
 
 std::vector<std::vector<sls::rt_data>> get_rt_work(int width, int height,
@@ -497,6 +1052,7 @@ std::vector<std::vector<sls::rt_data>> get_rt_work(int width, int height,
 //---------------------------------
 void init() {
   sphere_mesh.makeSubdivisionSphere(10);
+  quad_mesh.makeQuad();
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -574,14 +1130,12 @@ void setup_scene(vec4 const &material_diffuse, vec4 const &material_ambient,
   using namespace Angel;
   auto mtl = Material();
 
-  // cornell box sphere params (using big sphere wall hack)
-  auto r = 1e2;
+  // cornell box walls: the open front runs on past the default camera
+  // (distance 3)
   auto box_width = 1.0;
-  auto back_mv = Translate(0.0, 0.0, -r - box_width) * Scale(r, r, r);
-  auto left_mv = Translate(-r - box_width, 0, 0) * Scale(r, r, r);
-  auto right_mv = Translate(r + box_width, 0, 0) * Scale(r, r, r);
-  auto bottom_mv = Translate(0.0, -r - box_width, 0) * Scale(r, r, r);
-  auto top_mv = Translate(0.0, r + box_width, 0) * Scale(r, r, r);
+  auto box_depth = 6.0;
+  auto seam = 0.01;
+  auto const walls = cornell_wall_modelviews(box_width, box_depth, seam);
 
   auto gold_spec = vec4(1.0, 0.5, 0.1, 1.0);
   auto gold_diff = vec4(1.0, 1.0, 1.0, 1.0);
@@ -589,13 +1143,17 @@ void setup_scene(vec4 const &material_diffuse, vec4 const &material_ambient,
   auto iron_diff = vec4(1.0, 0.9, 0.9, 1.0);
   auto iron_spec = vec4(1.0, 1.0, 1.0, 1.0);
 
+  auto const vert_position = GLuint(glGetAttribLocation(program, "vPosition"));
+  auto const vert_normal = GLuint(glGetAttribLocation(program, "vNormal"));
+  auto const vert_texcoord = GLuint(glGetAttribLocation(program, "vTexCoord"));
+
   auto gl_mesh = make_shared<GLMesh>(ref(sphere_mesh));
-  gl_mesh->initialize_buffers(
-      GLuint(glGetAttribLocation(program, "vPosition")),
-      GLuint(glGetAttribLocation(program, "vNormal")),
-      GLuint(glGetAttribLocation(program, "vTexCoord")));
+  gl_mesh->initialize_buffers(vert_position, vert_normal, vert_texcoord);
+
+  auto quad_gl_mesh = make_shared<GLMesh>(ref(quad_mesh));
+  quad_gl_mesh->initialize_buffers(vert_position, vert_normal, vert_texcoord);
 
-  r = 0.25;
+  auto r = 0.25;
   auto mv =
       Angel::Translate(0.6f, -box_width + r, -0.4f) * Angel::Scale(r, r, r);
   auto gold_ball = make_shared<UnitSphere>(Material::gold(), mv, gl_mesh);
@@ -611,28 +1169,29 @@ void setup_scene(vec4 const &material_diffuse, vec4 const &material_ambient,
   scene.objects.push_back(clear_ball);
 
   auto plane =
-      std::make_shared<UnitSphere>(Material::wall_white(), back_mv, gl_mesh);
+      std::make_shared<Quad>(Material::wall_white(), walls.back, quad_gl_mesh);
   plane->name = "back";
   scene.objects.push_back(plane);
 
   // floor/ceil
 
-  plane =
-      std::make_shared<UnitSphere>(Material::wall_white(), bottom_mv, gl_mesh);
+  plane = std::make_shared<Quad>(Material::wall_white(), walls.bottom,
+                                 quad_gl_mesh);
   plane->name = "bottom";
   scene.objects.push_back(plane);
 
-  plane = std::make_shared<UnitSphere>(Material::wall_white(), top_mv, gl_mesh);
+  plane =
+      std::make_shared<Quad>(Material::wall_white(), walls.top, quad_gl_mesh);
   plane->name = "top";
   scene.objects.push_back(plane);
 
   // side walls
 
-  plane = std::make_shared<UnitSphere>(Material::wall_a(), left_mv, gl_mesh);
+  plane = std::make_shared<Quad>(Material::wall_a(), walls.left, quad_gl_mesh);
   plane->name = "left";
   scene.objects.push_back(plane);
 
-  plane = std::make_shared<UnitSphere>(Material::wall_b(), right_mv, gl_mesh);
+  plane = std::make_shared<Quad>(Material::wall_b(), walls.right, quad_gl_mesh);
   plane->name = "right";
   scene.objects.push_back(plane);
 
@@ -647,6 +1206,8 @@ void setup_scene(vec4 const &material_diffuse, vec4 const &material_ambient,
 
   scene.light_colors.push_back(lc);
   scene.light_locations.push_back(light_position);
+  scene.light_shapes.push_back(LightShape::quad(vec4(0.4, 0.0, 0.0, 0.0),
+                                                vec4(0.0, 0.0, 0.4, 0.0)));
 
   auto dir_light_color = LightColor();
   auto dir_light_loc = vec4(0.0, 0.5, 4.0, 0.0);
@@ -657,6 +1218,7 @@ void setup_scene(vec4 const &material_diffuse, vec4 const &material_ambient,
 
   scene.light_colors.push_back(dir_light_color);
   scene.light_locations.push_back(dir_light_loc);
+  scene.light_shapes.push_back(LightShape::sphere(0.2));
 }
 
 /* -------------------------------------------------------------------------- */
@@ -687,6 +1249,10 @@ void display(void) {
 
   auto n_lights = int(std::min(scene.n_lights(), max_lights));
 
+  // (view * object)^-1 = object^-1 * view^-1, and each object keeps its
+  // inverse, so the normal matrices cost one product per object
+  auto const view_inverse = invert_transform(model_view);
+
   glUniform4fv(light_unifs.light_locations, n_lights,
                &scene.light_locations[0].x);
   glUniform1i(light_unifs.n_lights, n_lights);
@@ -729,7 +1295,8 @@ void display(void) {
     glUniformMatrix4fv(ModelViewEarth, 1, GL_TRUE, mv_object);
     glUniformMatrix4fv(ModelViewLight, 1, GL_TRUE, model_view);
 
-    glUniformMatrix4fv(NormalMatrix, 1, GL_TRUE, transpose(invert(mv_object)));
+    glUniformMatrix4fv(NormalMatrix, 1, GL_TRUE,
+                       transpose(obj->modelview_inverse() * view_inverse));
 
     if (obj->mesh && obj->mesh->initialized) {
       obj->mesh->draw(vPosition, vNormal, vTexCoord);
@@ -869,9 +1436,10 @@ void keyboard(unsigned char key, int x, int y) {
       // set bind_viewport
       bind_viewport(nullptr);
 
-      auto cf = RTConfig();
+      auto max_samples = size_t(100);
+      auto cf = config_from_args(app_args, max_samples);
 
-      rt_flags.thread = std::thread(rayTrace, 100, cf);
+      rt_flags.thread = std::thread(rayTrace, max_samples, cf);
     } else {
       rt_flags.signal_quit_raytracing = true;
       cout << "raytracing in progress: will stop at end of next sample\n";
@@ -947,6 +1515,27 @@ int main(int argc, char **argv) {
 
   init();
 
+  // --sequence=<keyframe file> renders the whole path in batch and exits;
+  // the interactive view never runs, so nothing moves the camera mid-frame
+  if (app_args.named_args.count("sequence")) {
+    auto path = sls::KeyframePath();
+    if (!sls::KeyframePath::load(app_args.named_args.at("sequence"), path)) {
+      exit(EXIT_FAILURE);
+    }
+
+    int fb_width = 0, fb_height = 0;
+    glfwGetFramebufferSize(WINDOW, &fb_width, &fb_height);
+    reshape(WINDOW, fb_width, fb_height);
+    bind_viewport(nullptr);
+
+    auto max_samples = size_t(100);
+    auto cf = config_from_args(app_args, max_samples);
+    auto const ok = renderSequence(max_samples, cf, path);
+
+    glfwDestroyWindow(WINDOW);
+    return ok ? 0 : EXIT_FAILURE;
+  }
+
   glfwSetWindowSizeCallback(WINDOW, reshape);
   glfwSetMouseButtonCallback(WINDOW, mouse);
   glfwSetCursorPosCallback(WINDOW, motion);
@@ -0,0 +1,187 @@
+/**
+ * @file ${FILE}
+ * @brief keyframed camera and object paths for sequence renders
+ * @license ${LICENSE}
+ *
+ **/
+#ifndef RAYTRACER_ANIMATION_H
+#define RAYTRACER_ANIMATION_H
+
+#include "types.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sls {
+
+/**
+ * @brief a camera orbiting the origin, in the terms of the interactive view:
+ * yaw and pitch in degrees, then a pan and a pull back along -z
+ */
+struct CameraKey {
+  int frame = 0;
+  float yaw = 0.0f;
+  float pitch = 0.0f;
+  float distance = 3.0f;
+  vec2 pan = vec2(0.0, 0.0);
+
+  mat4 modelview() const {
+    return Angel::Translate(pan.x, pan.y, -distance) * Angel::RotateX(pitch) *
+           Angel::RotateY(yaw);
+  }
+};
+
+/**
+ * @brief an object moved by offset and turned by yaw degrees about its own
+ * center, relative to where the scene put it
+ */
+struct ObjectKey {
+  int frame = 0;
+  vec3 offset = vec3(0.0, 0.0, 0.0);
+  float yaw = 0.0f;
+
+  /**
+   * @param base the object's modelview before animation
+   */
+  mat4 modelview(mat4 const &base) const {
+    auto const center = base * vec4(0.0, 0.0, 0.0, 1.0);
+    return Angel::Translate(offset) * Angel::Translate(center) *
+           Angel::RotateY(yaw) * Angel::Translate(-center) * base;
+  }
+};
+
+/**
+ * @brief per-track keyframes, linearly interpolated and held before the
+ * first and after the last key.
+ * @detail Text format, one key per line, '#' starts a comment:
+ *
+ *     <frame> camera <yaw> <pitch> <distance> [<pan x> <pan y>]
+ *     <frame> object <name> <dx> <dy> <dz> [<yaw>]
+ *
+ * Frames run from 0 to the last key. A turntable is two camera keys, e.g.
+ * yaw 0 at frame 0 and yaw 357 at frame 119 for a 120 frame loop.
+ */
+class KeyframePath final {
+public:
+  static bool load(std::string const &filename, KeyframePath &path) {
+    auto file = std::ifstream(filename);
+    if (!file) {
+      std::cerr << "could not open keyframes " << filename << "\n";
+      return false;
+    }
+
+    path = KeyframePath();
+    auto line = std::string();
+    for (auto line_no = 1; std::getline(file, line); ++line_no) {
+      line = line.substr(0, line.find('#'));
+      auto in = std::istringstream(line);
+      auto frame = 0;
+      auto track = std::string();
+      if (!(in >> frame)) {
+        continue;
+      }
+
+      auto ok = bool(in >> track) && frame >= 0;
+      if (ok && track == "camera") {
+        auto key = CameraKey();
+        key.frame = frame;
+        ok = bool(in >> key.yaw >> key.pitch >> key.distance);
+        in >> key.pan.x >> key.pan.y;
+        path.camera_keys.push_back(key);
+      } else if (ok && track == "object") {
+        auto name = std::string();
+        auto key = ObjectKey();
+        key.frame = frame;
+        ok = bool(in >> name >> key.offset.x >> key.offset.y >> key.offset.z);
+        in >> key.yaw;
+        path.object_keys[name].push_back(key);
+      } else {
+        ok = false;
+      }
+
+      if (!ok) {
+        std::cerr << filename << ":" << line_no << ": bad keyframe\n";
+        return false;
+      }
+      path.last_frame = std::max(path.last_frame, frame);
+    }
+
+    auto by_frame = [](auto const &a, auto const &b) {
+      return a.frame < b.frame;
+    };
+    std::stable_sort(path.camera_keys.begin(), path.camera_keys.end(),
+                     by_frame);
+    for (auto &track : path.object_keys) {
+      std::stable_sort(track.second.begin(), track.second.end(), by_frame);
+    }
+    return true;
+  }
+
+  int n_frames() const { return last_frame + 1; }
+
+  /**
+   * @return the default view if there are no camera keys
+   */
+  CameraKey camera(int frame) const {
+    auto key = CameraKey();
+    if (camera_keys.empty()) {
+      return key;
+    }
+    auto a = CameraKey(), b = CameraKey();
+    auto const s = bracket(camera_keys, frame, a, b);
+    key.frame = frame;
+    key.yaw = mix(a.yaw, b.yaw, s);
+    key.pitch = mix(a.pitch, b.pitch, s);
+    key.distance = mix(a.distance, b.distance, s);
+    key.pan = a.pan + s * (b.pan - a.pan);
+    return key;
+  }
+
+  /**
+   * @return false if the object has no keys
+   */
+  bool object(std::string const &name, int frame, ObjectKey &key) const {
+    auto it = object_keys.find(name);
+    if (it == object_keys.end()) {
+      return false;
+    }
+    auto a = ObjectKey(), b = ObjectKey();
+    auto const s = bracket(it->second, frame, a, b);
+    key.frame = frame;
+    key.offset = a.offset + s * (b.offset - a.offset);
+    key.yaw = mix(a.yaw, b.yaw, s);
+    return true;
+  }
+
+private:
+  static float mix(float a, float b, float s) { return a + s * (b - a); }
+
+  /**
+   * @brief the keys around frame and the fraction of the way between them
+   */
+  template <typename KEY_T>
+  static float bracket(std::vector<KEY_T> const &keys, int frame, KEY_T &a,
+                       KEY_T &b) {
+    auto next = std::find_if(keys.begin(), keys.end(), [&](KEY_T const &k) {
+      return k.frame > frame;
+    });
+    if (next == keys.begin() || next == keys.end()) {
+      a = b = next == keys.end() ? keys.back() : keys.front();
+      return 0.0f;
+    }
+    a = *(next - 1);
+    b = *next;
+    return float(frame - a.frame) / float(b.frame - a.frame);
+  }
+
+  std::vector<CameraKey> camera_keys;
+  std::map<std::string, std::vector<ObjectKey>> object_keys;
+  int last_frame = 0;
+};
+}
+
+#endif // RAYTRACER_ANIMATION_H
@@ -8,9 +8,15 @@
 #ifndef RAYTRACER_THREADING_H
 #define RAYTRACER_THREADING_H
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <future>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <vector>
 
 /**
@@ -66,7 +72,8 @@ raycast_async(FN_T fn, std::vector<rt_data> const &work) {
 
   auto threads_used = set<size_t>();
 
-  auto work_fn = [&fn](vector<rt_data> generator) {
+  // fn is owned by the closure: the task outlives this stack frame
+  auto work_fn = [fn](vector<rt_data> generator) {
     cout << "\twork unit size " << generator.size() << "\n";
 
     for (auto &i : generator) {
@@ -78,6 +85,96 @@ raycast_async(FN_T fn, std::vector<rt_data> const &work) {
 
   return async(launch::async, move(work_fn), work);
 }
+
+/**
+ * @brief a fixed set of worker threads kept for the life of a batch render,
+ * so frames and samples don't pay for starting threads.
+ * @detail run() hands out task indices through a shared counter and blocks
+ * until every task has finished; one run() at a time.
+ */
+class WorkerPool final {
+public:
+  /**
+   * @param n_threads 0 uses every core
+   */
+  explicit WorkerPool(int n_threads = 0) {
+    auto const n =
+        n_threads > 0
+            ? n_threads
+            : int(std::max(1u, std::thread::hardware_concurrency()));
+    for (auto i = 0; i < n; ++i) {
+      workers.emplace_back([this]() { work(); });
+    }
+  }
+
+  WorkerPool(WorkerPool const &) = delete;
+  WorkerPool &operator=(WorkerPool const &) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  size_t size() const { return workers.size(); }
+
+  /**
+   * @brief calls fn(i) for every i in [0, n_tasks) on the workers
+   */
+  void run(size_t n_tasks, std::function<void(size_t)> const &fn) {
+    std::unique_lock<std::mutex> lock(mtx);
+    task = &fn;
+    task_count = n_tasks;
+    next = 0;
+    busy = workers.size();
+    ++generation;
+    wake.notify_all();
+    done.wait(lock, [this]() { return busy == 0; });
+    task = nullptr;
+  }
+
+private:
+  void work() {
+    auto seen = uint64_t(0);
+    std::unique_lock<std::mutex> lock(mtx);
+    for (;;) {
+      wake.wait(lock, [&]() { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+      auto const &fn = *task;
+      auto const count = task_count;
+
+      lock.unlock();
+      for (auto i = next++; i < count; i = next++) {
+        fn(i);
+      }
+      lock.lock();
+
+      if (--busy == 0) {
+        done.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mtx;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  std::function<void(size_t)> const *task = nullptr;
+  size_t task_count = 0;
+  std::atomic<size_t> next{0};
+  size_t busy = 0;
+  uint64_t generation = 0;
+  bool stopping = false;
+};
 }
 
 #endif // RAYTRACER_THREADING_H
@@ -11,6 +11,7 @@
 #include "common/Angel.h"
 #include "types.h"
 #include <array>
+#include <cmath>
 #include <functional>
 
 namespace sls {
@@ -62,6 +63,17 @@ static Angel::vec2 clamp(Angel::vec2 const &val, double const &low,
   return Angel::vec2(clamp(val.x, low, high), clamp(val.y, low, high));
 }
 
+/**
+ * @brief largest rgb component; the scalar size of a color weight
+ */
+static float max_rgb(Angel::vec4 const &v) {
+  return std::max(v.x, std::max(v.y, v.z));
+}
+
+static float max_rgb(Angel::vec3 const &v) {
+  return std::max(v.x, std::max(v.y, v.z));
+}
+
 //---------------------------------vector conversion
 //functions---------------------------------------
 
@@ -113,46 +125,95 @@ static ANGEL_VEC refract(ANGEL_VEC const &incident, ANGEL_VEC const &normal,
 
 //---------------------------------intersections---------------------------------------
 
-static double raySphereIntersection(vec4 p0, vec4 V,
-                                    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0),
-
-                                    double radius = 1.0) {
-  double t = -1.0;
-  double a = 1.0;
-  double b = dot(2 * V, p0 - origin);
-  double c = (length(p0 - origin) * length(p0 - origin)) - (radius * radius);
-
-  double temp = b * b - (4 * a * c);
-  if (temp < 0.0) {
-    return t;
+/**
+ * @brief per-ray values shared by every object a ray is tested against
+ * @detail Build one per ray, not per object. Kernels work along the unit
+ * direction and scale their distances back by t_scale, so results are in
+ * the units of the original ray, like the rest of the tracer expects.
+ */
+struct RayData {
+  Ray ray;
+  vec3 origin;
+  // unit direction
+  vec3 dir;
+  // 1 / dir per component; infinite along axes the ray is parallel to
+  vec3 inv_dir;
+  // 1 / length(ray.dir)
+  double t_scale;
+
+  explicit RayData(Ray const &ray)
+      : ray(ray), origin(xyz(ray.start)), dir(xyz(ray.dir)) {
+    auto const len = Angel::length(dir);
+    dir /= len;
+    inv_dir = vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+    t_scale = 1.0 / len;
   }
+};
 
-  if (near(temp, 0.0, 1e-7)) {
-    return (-b) / (2 * a);
+/**
+ * @brief nearest root of |origin + t dir - center| = radius in
+ * (t_min, t_max), or -1 if there is none
+ * @detail With a unit direction the quadratic is t^2 + 2bt + c = 0. The
+ * discriminant is taken as r^2 - |f - b dir|^2 rather than b^2 - c, which
+ * keeps its precision for large or distant spheres, and the roots as q and
+ * c / q so neither subtracts nearly equal values. A ray starting inside the
+ * sphere gets the exit point instead of the root behind it.
+ */
+static double ray_sphere_intersect(RayData const &ray, vec3 const &center,
+                                   double radius, double t_min = 0.0,
+                                   double t_max = INFINITY) {
+  auto const fx = double(ray.origin.x) - center.x;
+  auto const fy = double(ray.origin.y) - center.y;
+  auto const fz = double(ray.origin.z) - center.z;
+
+  auto const b = fx * ray.dir.x + fy * ray.dir.y + fz * ray.dir.z;
+  auto const c = fx * fx + fy * fy + fz * fz - radius * radius;
+
+  auto const hx = fx - b * ray.dir.x;
+  auto const hy = fy - b * ray.dir.y;
+  auto const hz = fz - b * ray.dir.z;
+  auto const discriminant = radius * radius - (hx * hx + hy * hy + hz * hz);
+  if (discriminant < 0.0) {
+    return -1.0;
   }
 
-  double t1 = (-b + sqrt(temp)) / (2 * a);
-  double t2 = (-b - sqrt(temp)) / (2 * a);
-  return (t1 < t2) ? t1 : t2;
-}
+  auto const q = -b - std::copysign(std::sqrt(discriminant), b);
+  auto const t0 = std::fmin(q, c / q) * ray.t_scale;
+  auto const t1 = std::fmax(q, c / q) * ray.t_scale;
 
-static double
-ray_plane_intersect(Ray const &ray,
-                    vec4 const &plane_p0 = vec4(0.0, 0.0, 0.0, 0.0),
-                    vec4 const &plane_n = vec4(0.0, 0.0, 1.0, 0.0)) {
-  using namespace Angel;
-  auto n_normal = normalize(plane_n);
-  auto n_dir = normalize(ray.dir);
-  auto denominator = dot(n_normal, n_dir);
-
-  if (denominator > 1e-7) {
-    auto dist = plane_p0 - ray.start;
-    auto t = dot(dist, plane_n) / denominator;
+  auto const t = t0 > t_min ? t0 : t1;
+  return (t > t_min && t < t_max) ? t : -1.0;
+}
 
-    return t;
+/**
+ * @brief slab test against the axis-aligned box [lo, hi]; nearest crossing
+ * of its surface in (t_min, t_max), or -1
+ * @detail Each axis clips the ray to the interval between its two planes and
+ * the box is the overlap of the three. A ray parallel to an axis has an
+ * infinite inverse direction there, so its interval is everything or
+ * nothing. A ray lying exactly in a face plane gets 0 * inf = NaN there,
+ * which fmin/fmax turn into an empty interval, so it grazes past as a miss.
+ */
+static double ray_box_intersect(RayData const &ray, vec3 const &lo,
+                                vec3 const &hi, double t_min = 0.0,
+                                double t_max = INFINITY) {
+  auto const lo_t = (lo - ray.origin) * ray.inv_dir;
+  auto const hi_t = (hi - ray.origin) * ray.inv_dir;
+
+  auto const t_near = std::fmax(std::fmax(std::fmin(lo_t.x, hi_t.x),
+                                          std::fmin(lo_t.y, hi_t.y)),
+                                std::fmin(lo_t.z, hi_t.z));
+  auto const t_far = std::fmin(std::fmin(std::fmax(lo_t.x, hi_t.x),
+                                         std::fmax(lo_t.y, hi_t.y)),
+                               std::fmax(lo_t.z, hi_t.z));
+  if (t_near > t_far) {
+    return -1.0;
   }
 
-  return -1;
+  auto const t0 = t_near * ray.t_scale;
+  auto const t1 = t_far * ray.t_scale;
+  auto const t = t0 > t_min ? t0 : t1;
+  return (t > t_min && t < t_max) ? t : -1.0;
 }
 
 } // namespace sls
@@ -237,6 +237,25 @@ public:
 
   bool makeParametricSphere(int steps = 32) { return true; }
 
+  // unit square in the z = 0 plane facing +z, as two triangles
+  bool makeQuad() {
+
+    Box_min = vec3(-0.5, -0.5, 0);
+    Box_max = vec3(0.5, 0.5, 0);
+
+    const vec2 corners[] = {vec2(0, 0), vec2(1, 0), vec2(1, 1),
+                            vec2(0, 0), vec2(1, 1), vec2(0, 1)};
+    for (unsigned int i = 0; i < 6; i++) {
+      vertices.push_back(
+          vec4(corners[i].x - 0.5f, corners[i].y - 0.5f, 0.0, 1.0));
+      normals.push_back(vec3(0, 0, 1));
+      uvs.push_back(corners[i]);
+    }
+    hasUV = true;
+
+    return true;
+  }
+
   friend std::ostream &operator<<(std::ostream &os, const Mesh &v) {
     os << "Vertices:\n";
     for (unsigned int i = 0; i < v.vertices.size(); i++) {
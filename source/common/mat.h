@@ -25,53 +25,42 @@ public:
   //  --- Constructors and Destructors ---
   //
 
-  mat2(const GLfloat d = GLfloat(1.0)) // Create a diagional matrix
-  {
-    _m[0].x = d;
-    _m[1].y = d;
-  }
+  constexpr mat2(const GLfloat d = GLfloat(1.0)) // Create a diagional matrix
+      : _m{vec2(d, 0.0), vec2(0.0, d)} {}
 
-  mat2(const vec2 &a, const vec2 &b) {
-    _m[0] = a;
-    _m[1] = b;
-  }
+  constexpr mat2(const vec2 &a, const vec2 &b) : _m{a, b} {}
 
-  mat2(GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11) {
-    _m[0] = vec2(m00, m10);
-    _m[1] = vec2(m01, m11);
-  }
+  constexpr mat2(GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11)
+      : _m{vec2(m00, m10), vec2(m01, m11)} {}
   // old version
   // { _m[0] = vec2( m00, m01 ); _m[1] = vec2( m10, m11 ); }
 
-  mat2(const mat2 &m) {
-    if (*this != m) {
-      _m[0] = m._m[0];
-      _m[1] = m._m[1];
-    }
-  }
+  constexpr mat2(const mat2 &m) = default;
 
   //
   //  --- Indexing Operator ---
   //
 
-  vec2 &operator[](int i) { return _m[i]; }
-  const vec2 &operator[](int i) const { return _m[i]; }
+  constexpr vec2 &operator[](int i) { return _m[i]; }
+  constexpr const vec2 &operator[](int i) const { return _m[i]; }
 
   //
   //  --- (non-modifying) Arithmatic Operators ---
   //
 
-  mat2 operator+(const mat2 &m) const {
+  constexpr mat2 operator+(const mat2 &m) const {
     return mat2(_m[0] + m[0], _m[1] + m[1]);
   }
 
-  mat2 operator-(const mat2 &m) const {
+  constexpr mat2 operator-(const mat2 &m) const {
     return mat2(_m[0] - m[0], _m[1] - m[1]);
   }
 
-  mat2 operator*(const GLfloat s) const { return mat2(s * _m[0], s * _m[1]); }
+  constexpr mat2 operator*(const GLfloat s) const {
+    return mat2(s * _m[0], s * _m[1]);
+  }
 
-  mat2 operator/(const GLfloat s) const {
+  constexpr mat2 operator/(const GLfloat s) const {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -84,9 +73,11 @@ public:
     return *this * r;
   }
 
-  friend mat2 operator*(const GLfloat s, const mat2 &m) { return m * s; }
+  friend constexpr mat2 operator*(const GLfloat s, const mat2 &m) {
+    return m * s;
+  }
 
-  mat2 operator*(const mat2 &m) const {
+  ANGEL_CONSTEXPR mat2 operator*(const mat2 &m) const {
     mat2 a(0.0);
 
     for (int i = 0; i < 2; ++i) {
@@ -104,25 +95,25 @@ public:
   //  --- (modifying) Arithmetic Operators ---
   //
 
-  mat2 &operator+=(const mat2 &m) {
+  constexpr mat2 &operator+=(const mat2 &m) {
     _m[0] += m[0];
     _m[1] += m[1];
     return *this;
   }
 
-  mat2 &operator-=(const mat2 &m) {
+  constexpr mat2 &operator-=(const mat2 &m) {
     _m[0] -= m[0];
     _m[1] -= m[1];
     return *this;
   }
 
-  mat2 &operator*=(const GLfloat s) {
+  constexpr mat2 &operator*=(const GLfloat s) {
     _m[0] *= s;
     _m[1] *= s;
     return *this;
   }
 
-  mat2 &operator*=(const mat2 &m) {
+  ANGEL_CONSTEXPR mat2 &operator*=(const mat2 &m) {
     mat2 a(0.0);
 
     for (int i = 0; i < 2; ++i) {
@@ -136,7 +127,7 @@ public:
     return *this = a;
   }
 
-  mat2 &operator/=(const GLfloat s) {
+  constexpr mat2 &operator/=(const GLfloat s) {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -163,7 +154,7 @@ public:
   //  --- Matrix / Vector operators ---
   //
 
-  vec2 operator*(const vec2 &v) const { // m * v
+  ANGEL_CONSTEXPR vec2 operator*(const vec2 &v) const { // m * v
     return vec2(_m[0][0] * v.x + _m[0][1] * v.y,
                 _m[1][0] * v.x + _m[1][1] * v.y);
   }
@@ -195,12 +186,12 @@ public:
 //  --- Non-class mat2 Methods ---
 //
 
-inline mat2 matrixCompMult(const mat2 &A, const mat2 &B) {
+ANGEL_CONSTEXPR mat2 matrixCompMult(const mat2 &A, const mat2 &B) {
   return mat2(A[0][0] * B[0][0], A[0][1] * B[0][1], A[1][0] * B[1][0],
               A[1][1] * B[1][1]);
 }
 
-inline mat2 transpose(const mat2 &A) {
+ANGEL_CONSTEXPR mat2 transpose(const mat2 &A) {
   return mat2(A[0][0], A[1][0], A[0][1], A[1][1]);
 }
 
@@ -218,61 +209,45 @@ public:
   //  --- Constructors and Destructors ---
   //
 
-  mat3(const GLfloat d = GLfloat(1.0)) // Create a diagional matrix
-  {
-    _m[0].x = d;
-    _m[1].y = d;
-    _m[2].z = d;
-  }
+  constexpr mat3(const GLfloat d = GLfloat(1.0)) // Create a diagional matrix
+      : _m{vec3(d, 0.0, 0.0), vec3(0.0, d, 0.0), vec3(0.0, 0.0, d)} {}
 
-  mat3(const vec3 &a, const vec3 &b, const vec3 &c) {
-    _m[0] = a;
-    _m[1] = b;
-    _m[2] = c;
-  }
+  constexpr mat3(const vec3 &a, const vec3 &b, const vec3 &c) : _m{a, b, c} {}
 
-  mat3(GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m01, GLfloat m11,
-       GLfloat m21, GLfloat m02, GLfloat m12, GLfloat m22) {
-    _m[0] = vec3(m00, m10, m20);
-    _m[1] = vec3(m01, m11, m21);
-    _m[2] = vec3(m02, m12, m22);
-    // _m[0] = vec3( m00, m01, m02 );
-    // _m[1] = vec3( m10, m11, m12 );
-    // _m[2] = vec3( m20, m21, m22 );
-  }
+  constexpr mat3(GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m01,
+                 GLfloat m11, GLfloat m21, GLfloat m02, GLfloat m12,
+                 GLfloat m22)
+      : _m{vec3(m00, m10, m20), vec3(m01, m11, m21), vec3(m02, m12, m22)} {}
+  // _m[0] = vec3( m00, m01, m02 );
+  // _m[1] = vec3( m10, m11, m12 );
+  // _m[2] = vec3( m20, m21, m22 );
 
-  mat3(const mat3 &m) {
-    if (*this != m) {
-      _m[0] = m._m[0];
-      _m[1] = m._m[1];
-      _m[2] = m._m[2];
-    }
-  }
+  constexpr mat3(const mat3 &m) = default;
 
   //
   //  --- Indexing Operator ---
   //
 
-  vec3 &operator[](int i) { return _m[i]; }
-  const vec3 &operator[](int i) const { return _m[i]; }
+  constexpr vec3 &operator[](int i) { return _m[i]; }
+  constexpr const vec3 &operator[](int i) const { return _m[i]; }
 
   //
   //  --- (non-modifying) Arithmatic Operators ---
   //
 
-  mat3 operator+(const mat3 &m) const {
+  constexpr mat3 operator+(const mat3 &m) const {
     return mat3(_m[0] + m[0], _m[1] + m[1], _m[2] + m[2]);
   }
 
-  mat3 operator-(const mat3 &m) const {
+  constexpr mat3 operator-(const mat3 &m) const {
     return mat3(_m[0] - m[0], _m[1] - m[1], _m[2] - m[2]);
   }
 
-  mat3 operator*(const GLfloat s) const {
+  constexpr mat3 operator*(const GLfloat s) const {
     return mat3(s * _m[0], s * _m[1], s * _m[2]);
   }
 
-  mat3 operator/(const GLfloat s) const {
+  constexpr mat3 operator/(const GLfloat s) const {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -285,9 +260,11 @@ public:
     return *this * r;
   }
 
-  friend mat3 operator*(const GLfloat s, const mat3 &m) { return m * s; }
+  friend constexpr mat3 operator*(const GLfloat s, const mat3 &m) {
+    return m * s;
+  }
 
-  mat3 operator*(const mat3 &m) const {
+  ANGEL_CONSTEXPR mat3 operator*(const mat3 &m) const {
     mat3 a(0.0);
 
     for (int i = 0; i < 3; ++i) {
@@ -305,28 +282,28 @@ public:
   //  --- (modifying) Arithmetic Operators ---
   //
 
-  mat3 &operator+=(const mat3 &m) {
+  constexpr mat3 &operator+=(const mat3 &m) {
     _m[0] += m[0];
     _m[1] += m[1];
     _m[2] += m[2];
     return *this;
   }
 
-  mat3 &operator-=(const mat3 &m) {
+  constexpr mat3 &operator-=(const mat3 &m) {
     _m[0] -= m[0];
     _m[1] -= m[1];
     _m[2] -= m[2];
     return *this;
   }
 
-  mat3 &operator*=(const GLfloat s) {
+  constexpr mat3 &operator*=(const GLfloat s) {
     _m[0] *= s;
     _m[1] *= s;
     _m[2] *= s;
     return *this;
   }
 
-  mat3 &operator*=(const mat3 &m) {
+  ANGEL_CONSTEXPR mat3 &operator*=(const mat3 &m) {
     mat3 a(0.0);
 
     for (int i = 0; i < 3; ++i) {
@@ -340,7 +317,7 @@ public:
     return *this = a;
   }
 
-  mat3 &operator/=(const GLfloat s) {
+  constexpr mat3 &operator/=(const GLfloat s) {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -357,7 +334,7 @@ public:
   //  --- Matrix / Vector operators ---
   //
 
-  vec3 operator*(const vec3 &v) const { // m * v
+  ANGEL_CONSTEXPR vec3 operator*(const vec3 &v) const { // m * v
     return vec3(_m[0][0] * v.x + _m[0][1] * v.y + _m[0][2] * v.z,
                 _m[1][0] * v.x + _m[1][1] * v.y + _m[1][2] * v.z,
                 _m[2][0] * v.x + _m[2][1] * v.y + _m[2][2] * v.z);
@@ -393,13 +370,13 @@ public:
 //  --- Non-class mat3 Methods ---
 //
 
-inline mat3 matrixCompMult(const mat3 &A, const mat3 &B) {
+ANGEL_CONSTEXPR mat3 matrixCompMult(const mat3 &A, const mat3 &B) {
   return mat3(A[0][0] * B[0][0], A[0][1] * B[0][1], A[0][2] * B[0][2],
               A[1][0] * B[1][0], A[1][1] * B[1][1], A[1][2] * B[1][2],
               A[2][0] * B[2][0], A[2][1] * B[2][1], A[2][2] * B[2][2]);
 }
 
-inline mat3 transpose(const mat3 &A) {
+ANGEL_CONSTEXPR mat3 transpose(const mat3 &A) {
   return mat3(A[0][0], A[1][0], A[2][0], A[0][1], A[1][1], A[2][1], A[0][2],
               A[1][2], A[2][2]);
 }
@@ -408,6 +385,9 @@ inline mat3 transpose(const mat3 &A) {
 //
 //  mat4.h - 4D square matrix
 //
+//    Rows are vec4s, so the matrix is 16-byte aligned and products work a
+//    row (one SSE register) at a time.
+//
 
 class mat4 {
 
@@ -418,68 +398,52 @@ public:
   //  --- Constructors and Destructors ---
   //
 
-  mat4(const GLfloat d = GLfloat(1.0)) // Create a diagional matrix
-  {
-    _m[0].x = d;
-    _m[1].y = d;
-    _m[2].z = d;
-    _m[3].w = d;
-  }
-
-  mat4(const vec4 &a, const vec4 &b, const vec4 &c, const vec4 &d) {
-    _m[0] = a;
-    _m[1] = b;
-    _m[2] = c;
-    _m[3] = d;
-  }
-
-  mat4(GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m30, GLfloat m01,
-       GLfloat m11, GLfloat m21, GLfloat m31, GLfloat m02, GLfloat m12,
-       GLfloat m22, GLfloat m32, GLfloat m03, GLfloat m13, GLfloat m23,
-       GLfloat m33) {
-    _m[0] = vec4(m00, m10, m20, m30);
-    _m[1] = vec4(m01, m11, m21, m31);
-    _m[2] = vec4(m02, m12, m22, m32);
-    _m[3] = vec4(m03, m13, m23, m33);
-    // _m[0] = vec4( m00, m01, m02, m03 );
-    // _m[1] = vec4( m10, m11, m12, m13 );
-    // _m[2] = vec4( m20, m21, m22, m23 );
-    // _m[3] = vec4( m30, m31, m32, m33 );
-  }
-
-  mat4(const mat4 &m) {
-    if (*this != m) {
-      _m[0] = m._m[0];
-      _m[1] = m._m[1];
-      _m[2] = m._m[2];
-      _m[3] = m._m[3];
-    }
-  }
+  constexpr mat4(const GLfloat d = GLfloat(1.0)) // Create a diagional matrix
+      : _m{vec4(d, 0.0, 0.0, 0.0), vec4(0.0, d, 0.0, 0.0),
+           vec4(0.0, 0.0, d, 0.0), vec4(0.0, 0.0, 0.0, d)} {}
+
+  constexpr mat4(const vec4 &a, const vec4 &b, const vec4 &c, const vec4 &d)
+      : _m{a, b, c, d} {}
+
+  constexpr mat4(GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m30,
+                 GLfloat m01, GLfloat m11, GLfloat m21, GLfloat m31,
+                 GLfloat m02, GLfloat m12, GLfloat m22, GLfloat m32,
+                 GLfloat m03, GLfloat m13, GLfloat m23, GLfloat m33)
+      : _m{vec4(m00, m10, m20, m30), vec4(m01, m11, m21, m31),
+           vec4(m02, m12, m22, m32), vec4(m03, m13, m23, m33)} {}
+  // _m[0] = vec4( m00, m01, m02, m03 );
+  // _m[1] = vec4( m10, m11, m12, m13 );
+  // _m[2] = vec4( m20, m21, m22, m23 );
+  // _m[3] = vec4( m30, m31, m32, m33 );
+
+  constexpr mat4(const mat4 &m) = default;
+
+  constexpr mat4 &operator=(const mat4 &m) = default;
 
   //
   //  --- Indexing Operator ---
   //
 
-  vec4 &operator[](int i) { return _m[i]; }
-  const vec4 &operator[](int i) const { return _m[i]; }
+  constexpr vec4 &operator[](int i) { return _m[i]; }
+  constexpr const vec4 &operator[](int i) const { return _m[i]; }
 
   //
   //  --- (non-modifying) Arithematic Operators ---
   //
 
-  mat4 operator+(const mat4 &m) const {
+  ANGEL_CONSTEXPR mat4 operator+(const mat4 &m) const {
     return mat4(_m[0] + m[0], _m[1] + m[1], _m[2] + m[2], _m[3] + m[3]);
   }
 
-  mat4 operator-(const mat4 &m) const {
+  ANGEL_CONSTEXPR mat4 operator-(const mat4 &m) const {
     return mat4(_m[0] - m[0], _m[1] - m[1], _m[2] - m[2], _m[3] - m[3]);
   }
 
-  mat4 operator*(const GLfloat s) const {
+  ANGEL_CONSTEXPR mat4 operator*(const GLfloat s) const {
     return mat4(s * _m[0], s * _m[1], s * _m[2], s * _m[3]);
   }
 
-  mat4 operator/(const GLfloat s) const {
+  ANGEL_CONSTEXPR mat4 operator/(const GLfloat s) const {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -492,11 +456,28 @@ public:
     return *this * r;
   }
 
-  friend mat4 operator*(const GLfloat s, const mat4 &m) { return m * s; }
+  friend ANGEL_CONSTEXPR mat4 operator*(const GLfloat s, const mat4 &m) {
+    return m * s;
+  }
 
-  mat4 operator*(const mat4 &m) const {
+  ANGEL_CONSTEXPR mat4 operator*(const mat4 &m) const {
     mat4 a(0.0);
 
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      // row i of the product is the rows of m weighted by row i of this
+      for (int i = 0; i < 4; ++i) {
+        __m128 r = _m[i].simd();
+        __m128 p = _mm_mul_ps(_mm_shuffle_ps(r, r, 0x00), m[0].simd());
+        p = _mm_add_ps(p, _mm_mul_ps(_mm_shuffle_ps(r, r, 0x55), m[1].simd()));
+        p = _mm_add_ps(p, _mm_mul_ps(_mm_shuffle_ps(r, r, 0xaa), m[2].simd()));
+        p = _mm_add_ps(p, _mm_mul_ps(_mm_shuffle_ps(r, r, 0xff), m[3].simd()));
+        a[i] = vec4(p);
+      }
+      return a;
+    }
+#endif
+
     for (int i = 0; i < 4; ++i) {
       for (int j = 0; j < 4; ++j) {
         for (int k = 0; k < 4; ++k) {
@@ -512,7 +493,7 @@ public:
   //  --- (modifying) Arithematic Operators ---
   //
 
-  mat4 &operator+=(const mat4 &m) {
+  ANGEL_CONSTEXPR mat4 &operator+=(const mat4 &m) {
     _m[0] += m[0];
     _m[1] += m[1];
     _m[2] += m[2];
@@ -520,7 +501,7 @@ public:
     return *this;
   }
 
-  mat4 &operator-=(const mat4 &m) {
+  ANGEL_CONSTEXPR mat4 &operator-=(const mat4 &m) {
     _m[0] -= m[0];
     _m[1] -= m[1];
     _m[2] -= m[2];
@@ -528,7 +509,7 @@ public:
     return *this;
   }
 
-  mat4 &operator*=(const GLfloat s) {
+  ANGEL_CONSTEXPR mat4 &operator*=(const GLfloat s) {
     _m[0] *= s;
     _m[1] *= s;
     _m[2] *= s;
@@ -536,21 +517,9 @@ public:
     return *this;
   }
 
-  mat4 &operator*=(const mat4 &m) {
-    mat4 a(0.0);
+  ANGEL_CONSTEXPR mat4 &operator*=(const mat4 &m) { return *this = *this * m; }
 
-    for (int i = 0; i < 4; ++i) {
-      for (int j = 0; j < 4; ++j) {
-        for (int k = 0; k < 4; ++k) {
-          a[i][j] += _m[i][k] * m[k][j];
-        }
-      }
-    }
-
-    return *this = a;
-  }
-
-  mat4 &operator/=(const GLfloat s) {
+  ANGEL_CONSTEXPR mat4 &operator/=(const GLfloat s) {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -567,12 +536,23 @@ public:
   //  --- Matrix / Vector operators ---
   //
 
-  vec4 operator*(const vec4 &v) const { // m * v
-    return vec4(
-        _m[0][0] * v.x + _m[0][1] * v.y + _m[0][2] * v.z + _m[0][3] * v.w,
-        _m[1][0] * v.x + _m[1][1] * v.y + _m[1][2] * v.z + _m[1][3] * v.w,
-        _m[2][0] * v.x + _m[2][1] * v.y + _m[2][2] * v.z + _m[2][3] * v.w,
-        _m[3][0] * v.x + _m[3][1] * v.y + _m[3][2] * v.z + _m[3][3] * v.w);
+  ANGEL_CONSTEXPR vec4 operator*(const vec4 &v) const { // m * v
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      // the four row products, summed pairwise across rows so each lane of
+      // the result ends up with one row's total
+      __m128 m = v.simd();
+      __m128 r0 = _mm_mul_ps(_m[0].simd(), m);
+      __m128 r1 = _mm_mul_ps(_m[1].simd(), m);
+      __m128 r2 = _mm_mul_ps(_m[2].simd(), m);
+      __m128 r3 = _mm_mul_ps(_m[3].simd(), m);
+      __m128 s01 = _mm_add_ps(_mm_unpacklo_ps(r0, r1), _mm_unpackhi_ps(r0, r1));
+      __m128 s23 = _mm_add_ps(_mm_unpacklo_ps(r2, r3), _mm_unpackhi_ps(r2, r3));
+      return vec4(
+          _mm_add_ps(_mm_movelh_ps(s01, s23), _mm_movehl_ps(s23, s01)));
+    }
+#endif
+    return vec4(dot(_m[0], v), dot(_m[1], v), dot(_m[2], v), dot(_m[3], v));
   }
 
   //
@@ -606,7 +586,7 @@ public:
 //  --- Non-class mat4 Methods ---
 //
 
-inline mat4 matrixCompMult(const mat4 &A, const mat4 &B) {
+ANGEL_CONSTEXPR mat4 matrixCompMult(const mat4 &A, const mat4 &B) {
   return mat4(A[0][0] * B[0][0], A[0][1] * B[0][1], A[0][2] * B[0][2],
               A[0][3] * B[0][3], A[1][0] * B[1][0], A[1][1] * B[1][1],
               A[1][2] * B[1][2], A[1][3] * B[1][3], A[2][0] * B[2][0],
@@ -615,7 +595,15 @@ inline mat4 matrixCompMult(const mat4 &A, const mat4 &B) {
               A[3][3] * B[3][3]);
 }
 
-inline mat4 transpose(const mat4 &A) {
+ANGEL_CONSTEXPR mat4 transpose(const mat4 &A) {
+#ifdef ANGEL_SIMD
+  if (!ANGEL_CONSTANT_EVALUATED()) {
+    __m128 r0 = A[0].simd(), r1 = A[1].simd(), r2 = A[2].simd(),
+           r3 = A[3].simd();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    return mat4(vec4(r0), vec4(r1), vec4(r2), vec4(r3));
+  }
+#endif
   return mat4(A[0][0], A[1][0], A[2][0], A[3][0], A[0][1], A[1][1], A[2][1],
               A[3][1], A[0][2], A[1][2], A[2][2], A[3][2], A[0][3], A[1][3],
               A[2][3], A[3][3]);
@@ -685,32 +673,26 @@ inline mat4 RotateZ(const GLfloat theta) {
 //  Translation matrix generators
 //
 
-inline mat4 Translate(const GLfloat x, const GLfloat y, const GLfloat z) {
-  mat4 c;
-  c[0][3] = x;
-  c[1][3] = y;
-  c[2][3] = z;
-  return c;
+constexpr mat4 Translate(const GLfloat x, const GLfloat y, const GLfloat z) {
+  return mat4(vec4(1.0, 0.0, 0.0, x), vec4(0.0, 1.0, 0.0, y),
+              vec4(0.0, 0.0, 1.0, z), vec4(0.0, 0.0, 0.0, 1.0));
 }
 
-inline mat4 Translate(const vec3 &v) { return Translate(v.x, v.y, v.z); }
+constexpr mat4 Translate(const vec3 &v) { return Translate(v.x, v.y, v.z); }
 
-inline mat4 Translate(const vec4 &v) { return Translate(v.x, v.y, v.z); }
+constexpr mat4 Translate(const vec4 &v) { return Translate(v.x, v.y, v.z); }
 
 //----------------------------------------------------------------------------
 //
 //  Scale matrix generators
 //
 
-inline mat4 Scale(const GLfloat x, const GLfloat y, const GLfloat z) {
-  mat4 c;
-  c[0][0] = x;
-  c[1][1] = y;
-  c[2][2] = z;
-  return c;
+constexpr mat4 Scale(const GLfloat x, const GLfloat y, const GLfloat z) {
+  return mat4(vec4(x, 0.0, 0.0, 0.0), vec4(0.0, y, 0.0, 0.0),
+              vec4(0.0, 0.0, z, 0.0), vec4(0.0, 0.0, 0.0, 1.0));
 }
 
-inline mat4 Scale(const vec3 &v) { return Scale(v.x, v.y, v.z); }
+constexpr mat4 Scale(const vec3 &v) { return Scale(v.x, v.y, v.z); }
 
 //----------------------------------------------------------------------------
 //
@@ -721,8 +703,9 @@ inline mat4 Scale(const vec3 &v) { return Scale(v.x, v.y, v.z); }
 //          "zNear" to reprsent "near", and "zFar" to reprsent "far".
 //
 
-inline mat4 Ortho(const GLfloat left, const GLfloat right, const GLfloat bottom,
-                  const GLfloat top, const GLfloat zNear, const GLfloat zFar) {
+ANGEL_CONSTEXPR mat4 Ortho(const GLfloat left, const GLfloat right,
+                           const GLfloat bottom, const GLfloat top,
+                           const GLfloat zNear, const GLfloat zFar) {
   mat4 c;
   c[0][0] = 2.0 / (right - left);
   c[1][1] = 2.0 / (top - bottom);
@@ -734,14 +717,14 @@ inline mat4 Ortho(const GLfloat left, const GLfloat right, const GLfloat bottom,
   return c;
 }
 
-inline mat4 Ortho2D(const GLfloat left, const GLfloat right,
-                    const GLfloat bottom, const GLfloat top) {
+ANGEL_CONSTEXPR mat4 Ortho2D(const GLfloat left, const GLfloat right,
+                             const GLfloat bottom, const GLfloat top) {
   return Ortho(left, right, bottom, top, -1.0, 1.0);
 }
 
-inline mat4 Frustum(const GLfloat left, const GLfloat right,
-                    const GLfloat bottom, const GLfloat top,
-                    const GLfloat zNear, const GLfloat zFar) {
+ANGEL_CONSTEXPR mat4 Frustum(const GLfloat left, const GLfloat right,
+                             const GLfloat bottom, const GLfloat top,
+                             const GLfloat zNear, const GLfloat zFar) {
   mat4 c;
   c[0][0] = 2.0 * zNear / (right - left);
   c[0][2] = (right + left) / (right - left);
@@ -787,9 +770,9 @@ inline mat4 LookAt(const vec4 &eye, const vec4 &at, const vec4 &up) {
 //
 // Generates a Normal Matrix
 //
-inline mat3 Normal(const mat4 &c) {
+ANGEL_CONSTEXPR mat3 Normal(const mat4 &c) {
   mat3 d;
-  GLfloat det;
+  GLfloat det = 0.0;
 
   det = c[0][0] * c[1][1] * c[2][2] + c[0][1] * c[1][2] * c[2][1] +
         c[0][2] * c[1][0] * c[2][1] - c[2][0] * c[1][1] * c[0][2] -
@@ -808,8 +791,8 @@ inline mat3 Normal(const mat4 &c) {
   return d;
 }
 
-inline double determinant(mat4 m) {
-  double value;
+ANGEL_CONSTEXPR double determinant(mat4 m) {
+  double value = 0.0;
   value = m[3][0] * m[2][1] * m[1][2] * m[0][3] -
           m[2][0] * m[3][1] * m[1][2] * m[0][3] -
           m[3][0] * m[1][1] * m[2][2] * m[0][3] +
@@ -837,7 +820,7 @@ inline double determinant(mat4 m) {
   return value;
 }
 
-inline mat4 invert(mat4 m) {
+ANGEL_CONSTEXPR mat4 invert(mat4 m) {
   mat4 output;
   output[0][0] = m[2][1] * m[3][2] * m[1][3] - m[3][1] * m[2][2] * m[1][3] +
                  m[3][1] * m[1][2] * m[2][3] - m[1][1] * m[3][2] * m[2][3] -
@@ -891,6 +874,84 @@ inline mat4 invert(mat4 m) {
   return (1.0 / determinant(m)) * output;
 }
 
+//----------------------------------------------------------------------------
+//
+//  AffineTransform - a 3x3 linear part and a translation
+//
+//    Everything built from Translate, Scale and Rotate* is affine: the
+//    bottom row of its mat4 is ( 0, 0, 0, 1 ).  Dropping that row makes
+//    composition and inversion cheaper, and points, vectors and normals
+//    transform without a homogeneous coordinate.
+//
+
+struct AffineTransform {
+
+  mat3 linear;
+  vec3 translation;
+
+  constexpr AffineTransform() : linear(1.0), translation(0.0) {}
+
+  constexpr AffineTransform(const mat3 &linear, const vec3 &translation)
+      : linear(linear), translation(translation) {}
+
+  //  the top three rows of m; its bottom row is taken to be ( 0, 0, 0, 1 )
+  ANGEL_CONSTEXPR explicit AffineTransform(const mat4 &m)
+      : linear(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[2][0],
+               m[2][1], m[2][2]),
+        translation(m[0][3], m[1][3], m[2][3]) {}
+
+  constexpr mat4 to_mat4() const {
+    return mat4(vec4(linear[0], translation.x), vec4(linear[1], translation.y),
+                vec4(linear[2], translation.z), vec4(0.0, 0.0, 0.0, 1.0));
+  }
+
+  //  applies b first, then this
+  ANGEL_CONSTEXPR AffineTransform operator*(const AffineTransform &b) const {
+    return AffineTransform(linear * b.linear,
+                           linear * b.translation + translation);
+  }
+};
+
+ANGEL_CONSTEXPR vec3 transform_point(const AffineTransform &a, const vec3 &p) {
+  return a.linear * p + a.translation;
+}
+
+ANGEL_CONSTEXPR vec3 transform_vector(const AffineTransform &a, const vec3 &v) {
+  return a.linear * v;
+}
+
+//  normals go through the inverse transpose, so this takes the inverse of
+//    the transform that moved the surface
+ANGEL_CONSTEXPR vec3 transform_normal(const AffineTransform &inverse,
+                                      const vec3 &n) {
+  const mat3 &m = inverse.linear;
+  return n.x * m[0] + n.y * m[1] + n.z * m[2];
+}
+
+//  closed-form inverse: the columns of the inverse linear part are cross
+//    products of its rows over the determinant, and the translation is
+//    undone in the inverted frame
+ANGEL_CONSTEXPR AffineTransform inverse(const AffineTransform &a) {
+  const mat3 &m = a.linear;
+  vec3 c0 = cross(m[1], m[2]);
+  vec3 c1 = cross(m[2], m[0]);
+  vec3 c2 = cross(m[0], m[1]);
+  GLfloat r = GLfloat(1.0) / dot(m[0], c0);
+
+  mat3 inv = transpose(mat3(r * c0, r * c1, r * c2));
+  return AffineTransform(inv, -(inv * a.translation));
+}
+
+ANGEL_CONSTEXPR bool is_affine(const mat4 &m) {
+  return m[3][0] == 0.0 && m[3][1] == 0.0 && m[3][2] == 0.0 && m[3][3] == 1.0;
+}
+
+//  inverse of a model-view matrix: closed form when it is affine, the
+//    general 4x4 inverse otherwise
+ANGEL_CONSTEXPR mat4 invert_transform(const mat4 &m) {
+  return is_affine(m) ? inverse(AffineTransform(m)).to_mat4() : invert(m);
+}
+
 //----------------------------------------------------------------------------
 
 inline vec4 minus(const vec4 &a, const vec4 &b) {
@@ -9,6 +9,34 @@
 
 #include "Angel.h"
 
+//  vec4 and mat4 use SSE when the target has it; define ANGEL_NO_SIMD to
+//    force the scalar code
+#if defined(__SSE__) && !defined(ANGEL_NO_SIMD)
+#define ANGEL_SIMD 1
+#include <xmmintrin.h>
+#endif
+
+//  Constructors, scalar operators and the transform generators are
+//    constexpr.  Functions with a faster run-time path (SSE, or indexing by
+//    pointer) are ANGEL_CONSTEXPR: they take the plain path when evaluated
+//    at compile time, which needs __builtin_is_constant_evaluated (GCC 9,
+//    Clang 9); older compilers get them as ordinary inline functions.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define ANGEL_HAS_CONSTANT_EVALUATED 1
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define ANGEL_HAS_CONSTANT_EVALUATED 1
+#endif
+
+#ifdef ANGEL_HAS_CONSTANT_EVALUATED
+#define ANGEL_CONSTEXPR constexpr
+#define ANGEL_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#define ANGEL_CONSTEXPR inline
+#define ANGEL_CONSTANT_EVALUATED() false
+#endif
+
 namespace Angel {
 
 //////////////////////////////////////////////////////////////////////////////
@@ -25,43 +53,58 @@ struct vec2 {
   //  --- Constructors and Destructors ---
   //
 
-  vec2(GLfloat s = GLfloat(0.0)) : x(s), y(s) {}
+  constexpr vec2(GLfloat s = GLfloat(0.0)) : x(s), y(s) {}
 
-  vec2(GLfloat x, GLfloat y) : x(x), y(y) {}
+  constexpr vec2(GLfloat x, GLfloat y) : x(x), y(y) {}
 
-  vec2(const vec2 &v) {
-    x = v.x;
-    y = v.y;
-  }
+  constexpr vec2(const vec2 &v) = default;
 
   //
   //  --- Indexing Operator ---
   //
 
-  GLfloat &operator[](int i) { return *(&x + i); }
+  ANGEL_CONSTEXPR GLfloat &operator[](int i) {
+    if (ANGEL_CONSTANT_EVALUATED()) {
+      return i == 0 ? x : y;
+    }
+    return *(&x + i);
+  }
 
-  const GLfloat operator[](int i) const { return *(&x + i); }
+  ANGEL_CONSTEXPR const GLfloat operator[](int i) const {
+    if (ANGEL_CONSTANT_EVALUATED()) {
+      return i == 0 ? x : y;
+    }
+    return *(&x + i);
+  }
 
   //
   //  --- (non-modifying) Arithematic Operators ---
   //
 
-  vec2 operator-() const // unary minus operator
+  constexpr vec2 operator-() const // unary minus operator
   {
     return vec2(-x, -y);
   }
 
-  vec2 operator+(const vec2 &v) const { return vec2(x + v.x, y + v.y); }
+  constexpr vec2 operator+(const vec2 &v) const {
+    return vec2(x + v.x, y + v.y);
+  }
 
-  vec2 operator-(const vec2 &v) const { return vec2(x - v.x, y - v.y); }
+  constexpr vec2 operator-(const vec2 &v) const {
+    return vec2(x - v.x, y - v.y);
+  }
 
-  vec2 operator*(const GLfloat s) const { return vec2(s * x, s * y); }
+  constexpr vec2 operator*(const GLfloat s) const { return vec2(s * x, s * y); }
 
-  vec2 operator*(const vec2 &v) const { return vec2(x * v.x, y * v.y); }
+  constexpr vec2 operator*(const vec2 &v) const {
+    return vec2(x * v.x, y * v.y);
+  }
 
-  friend vec2 operator*(const GLfloat s, const vec2 &v) { return v * s; }
+  friend constexpr vec2 operator*(const GLfloat s, const vec2 &v) {
+    return v * s;
+  }
 
-  vec2 operator/(const GLfloat s) const {
+  constexpr vec2 operator/(const GLfloat s) const {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -78,31 +121,31 @@ struct vec2 {
   //  --- (modifying) Arithematic Operators ---
   //
 
-  vec2 &operator+=(const vec2 &v) {
+  constexpr vec2 &operator+=(const vec2 &v) {
     x += v.x;
     y += v.y;
     return *this;
   }
 
-  vec2 &operator-=(const vec2 &v) {
+  constexpr vec2 &operator-=(const vec2 &v) {
     x -= v.x;
     y -= v.y;
     return *this;
   }
 
-  vec2 &operator*=(const GLfloat s) {
+  constexpr vec2 &operator*=(const GLfloat s) {
     x *= s;
     y *= s;
     return *this;
   }
 
-  vec2 &operator*=(const vec2 &v) {
+  constexpr vec2 &operator*=(const vec2 &v) {
     x *= v.x;
     y *= v.y;
     return *this;
   }
 
-  vec2 &operator/=(const GLfloat s) {
+  constexpr vec2 &operator/=(const GLfloat s) {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -142,7 +185,7 @@ struct vec2 {
 //  Non-class vec2 Methods
 //
 
-inline GLfloat dot(const vec2 &u, const vec2 &v) {
+constexpr GLfloat dot(const vec2 &u, const vec2 &v) {
   return u.x * v.x + u.y * v.y;
 }
 
@@ -166,56 +209,62 @@ struct vec3 {
   //  --- Constructors and Destructors ---
   //
 
-  vec3(GLfloat s = GLfloat(0.0)) : x(s), y(s), z(s) {}
+  constexpr vec3(GLfloat s = GLfloat(0.0)) : x(s), y(s), z(s) {}
 
-  vec3(GLfloat x, GLfloat y, GLfloat z) : x(x), y(y), z(z) {}
+  constexpr vec3(GLfloat x, GLfloat y, GLfloat z) : x(x), y(y), z(z) {}
 
-  vec3(const vec3 &v) {
-    x = v.x;
-    y = v.y;
-    z = v.z;
-  }
+  constexpr vec3(const vec3 &v) = default;
 
-  vec3(const vec2 &v, const float f) {
-    x = v.x;
-    y = v.y;
-    z = f;
-  }
+  constexpr vec3(const vec2 &v, const float f) : x(v.x), y(v.y), z(f) {}
 
   //
   //  --- Indexing Operator ---
   //
 
-  GLfloat &operator[](int i) { return *(&x + i); }
+  ANGEL_CONSTEXPR GLfloat &operator[](int i) {
+    if (ANGEL_CONSTANT_EVALUATED()) {
+      return i == 0 ? x : i == 1 ? y : z;
+    }
+    return *(&x + i);
+  }
 
-  const GLfloat operator[](int i) const { return *(&x + i); }
+  ANGEL_CONSTEXPR const GLfloat operator[](int i) const {
+    if (ANGEL_CONSTANT_EVALUATED()) {
+      return i == 0 ? x : i == 1 ? y : z;
+    }
+    return *(&x + i);
+  }
 
   //
   //  --- (non-modifying) Arithematic Operators ---
   //
 
-  vec3 operator-() const // unary minus operator
+  constexpr vec3 operator-() const // unary minus operator
   {
     return vec3(-x, -y, -z);
   }
 
-  vec3 operator+(const vec3 &v) const {
+  constexpr vec3 operator+(const vec3 &v) const {
     return vec3(x + v.x, y + v.y, z + v.z);
   }
 
-  vec3 operator-(const vec3 &v) const {
+  constexpr vec3 operator-(const vec3 &v) const {
     return vec3(x - v.x, y - v.y, z - v.z);
   }
 
-  vec3 operator*(const GLfloat s) const { return vec3(s * x, s * y, s * z); }
+  constexpr vec3 operator*(const GLfloat s) const {
+    return vec3(s * x, s * y, s * z);
+  }
 
-  vec3 operator*(const vec3 &v) const {
+  constexpr vec3 operator*(const vec3 &v) const {
     return vec3(x * v.x, y * v.y, z * v.z);
   }
 
-  friend vec3 operator*(const GLfloat s, const vec3 &v) { return v * s; }
+  friend constexpr vec3 operator*(const GLfloat s, const vec3 &v) {
+    return v * s;
+  }
 
-  vec3 operator/(const GLfloat s) const {
+  constexpr vec3 operator/(const GLfloat s) const {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -232,35 +281,35 @@ struct vec3 {
   //  --- (modifying) Arithematic Operators ---
   //
 
-  vec3 &operator+=(const vec3 &v) {
+  constexpr vec3 &operator+=(const vec3 &v) {
     x += v.x;
     y += v.y;
     z += v.z;
     return *this;
   }
 
-  vec3 &operator-=(const vec3 &v) {
+  constexpr vec3 &operator-=(const vec3 &v) {
     x -= v.x;
     y -= v.y;
     z -= v.z;
     return *this;
   }
 
-  vec3 &operator*=(const GLfloat s) {
+  constexpr vec3 &operator*=(const GLfloat s) {
     x *= s;
     y *= s;
     z *= s;
     return *this;
   }
 
-  vec3 &operator*=(const vec3 &v) {
+  constexpr vec3 &operator*=(const vec3 &v) {
     x *= v.x;
     y *= v.y;
     z *= v.z;
     return *this;
   }
 
-  vec3 &operator/=(const GLfloat s) {
+  constexpr vec3 &operator/=(const GLfloat s) {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -300,7 +349,7 @@ struct vec3 {
 //  Non-class vec3 Methods
 //
 
-inline GLfloat dot(const vec3 &u, const vec3 &v) {
+constexpr GLfloat dot(const vec3 &u, const vec3 &v) {
   return u.x * v.x + u.y * v.y + u.z * v.z;
 }
 
@@ -308,7 +357,7 @@ inline GLfloat length(const vec3 &v) { return std::sqrt(dot(v, v)); }
 
 inline vec3 normalize(const vec3 &v) { return v / length(v); }
 
-inline vec3 cross(const vec3 &a, const vec3 &b) {
+constexpr vec3 cross(const vec3 &a, const vec3 &b) {
   return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
               a.x * b.y - a.y * b.x);
 }
@@ -317,9 +366,12 @@ inline vec3 cross(const vec3 &a, const vec3 &b) {
 //
 //  vec4 - 4D vector
 //
+//    16-byte aligned so the four components load as one SSE register;
+//    the layout is still four packed floats, as OpenGL expects.
+//
 //////////////////////////////////////////////////////////////////////////////
 
-struct vec4 {
+struct alignas(16) vec4 {
 
   GLfloat x;
   GLfloat y;
@@ -330,64 +382,100 @@ struct vec4 {
   //  --- Constructors and Destructors ---
   //
 
-  vec4(GLfloat s = GLfloat(0.0)) : x(s), y(s), z(s), w(s) {}
+  constexpr vec4(GLfloat s = GLfloat(0.0)) : x(s), y(s), z(s), w(s) {}
 
-  vec4(GLfloat x, GLfloat y, GLfloat z, GLfloat w) : x(x), y(y), z(z), w(w) {}
+  constexpr vec4(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+      : x(x), y(y), z(z), w(w) {}
 
-  vec4(const vec4 &v) {
-    x = v.x;
-    y = v.y;
-    z = v.z;
-    w = v.w;
-  }
+  constexpr vec4(const vec4 &v) = default;
 
-  vec4(const vec3 &v, const float w = 1.0) : w(w) {
-    x = v.x;
-    y = v.y;
-    z = v.z;
-  }
+  constexpr vec4 &operator=(const vec4 &v) = default;
 
-  vec4(const vec2 &v, const float z, const float w) : z(z), w(w) {
-    x = v.x;
-    y = v.y;
-  }
+#ifdef ANGEL_SIMD
+  explicit vec4(__m128 m) { _mm_store_ps(&x, m); }
+
+  __m128 simd() const { return _mm_load_ps(&x); }
+#endif
+
+  constexpr vec4(const vec3 &v, const float w = 1.0)
+      : x(v.x), y(v.y), z(v.z), w(w) {}
+
+  constexpr vec4(const vec2 &v, const float z, const float w)
+      : x(v.x), y(v.y), z(z), w(w) {}
 
   //
   //  --- Indexing Operator ---
   //
 
-  GLfloat &operator[](int i) { return *(&x + i); }
+  ANGEL_CONSTEXPR GLfloat &operator[](int i) {
+    if (ANGEL_CONSTANT_EVALUATED()) {
+      return i == 0 ? x : i == 1 ? y : i == 2 ? z : w;
+    }
+    return *(&x + i);
+  }
 
-  const GLfloat operator[](int i) const { return *(&x + i); }
+  ANGEL_CONSTEXPR const GLfloat operator[](int i) const {
+    if (ANGEL_CONSTANT_EVALUATED()) {
+      return i == 0 ? x : i == 1 ? y : i == 2 ? z : w;
+    }
+    return *(&x + i);
+  }
 
   //
   //  --- (non-modifying) Arithematic Operators ---
   //
 
-  vec4 operator-() const // unary minus operator
+  ANGEL_CONSTEXPR vec4 operator-() const // unary minus operator
   {
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      return vec4(_mm_xor_ps(simd(), _mm_set1_ps(-0.0f)));
+    }
+#endif
     return vec4(-x, -y, -z, -w);
   }
 
-  vec4 operator+(const vec4 &v) const {
+  ANGEL_CONSTEXPR vec4 operator+(const vec4 &v) const {
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      return vec4(_mm_add_ps(simd(), v.simd()));
+    }
+#endif
     return vec4(x + v.x, y + v.y, z + v.z, w + v.w);
   }
 
-  vec4 operator-(const vec4 &v) const {
+  ANGEL_CONSTEXPR vec4 operator-(const vec4 &v) const {
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      return vec4(_mm_sub_ps(simd(), v.simd()));
+    }
+#endif
     return vec4(x - v.x, y - v.y, z - v.z, w - v.w);
   }
 
-  vec4 operator*(const GLfloat s) const {
+  ANGEL_CONSTEXPR vec4 operator*(const GLfloat s) const {
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      return vec4(_mm_mul_ps(simd(), _mm_set1_ps(s)));
+    }
+#endif
     return vec4(s * x, s * y, s * z, s * w);
   }
 
-  vec4 operator*(const vec4 &v) const {
-    return vec4(x * v.x, y * v.y, z * v.z, w * v.z);
+  ANGEL_CONSTEXPR vec4 operator*(const vec4 &v) const {
+#ifdef ANGEL_SIMD
+    if (!ANGEL_CONSTANT_EVALUATED()) {
+      return vec4(_mm_mul_ps(simd(), v.simd()));
+    }
+#endif
+    return vec4(x * v.x, y * v.y, z * v.z, w * v.w);
   }
 
-  friend vec4 operator*(const GLfloat s, const vec4 &v) { return v * s; }
+  friend ANGEL_CONSTEXPR vec4 operator*(const GLfloat s, const vec4 &v) {
+    return v * s;
+  }
 
-  vec4 operator/(const GLfloat s) const {
+  ANGEL_CONSTEXPR vec4 operator/(const GLfloat s) const {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -404,36 +492,17 @@ struct vec4 {
   //  --- (modifying) Arithematic Operators ---
   //
 
-  vec4 &operator+=(const vec4 &v) {
-    x += v.x;
-    y += v.y;
-    z += v.z;
-    w += v.w;
-    return *this;
-  }
+  ANGEL_CONSTEXPR vec4 &operator+=(const vec4 &v) { return *this = *this + v; }
 
-  vec4 &operator-=(const vec4 &v) {
-    x -= v.x;
-    y -= v.y;
-    z -= v.z;
-    w -= v.w;
-    return *this;
-  }
+  ANGEL_CONSTEXPR vec4 &operator-=(const vec4 &v) { return *this = *this - v; }
 
-  vec4 &operator*=(const GLfloat s) {
-    x *= s;
-    y *= s;
-    z *= s;
-    w *= s;
-    return *this;
+  ANGEL_CONSTEXPR vec4 &operator*=(const GLfloat s) {
+    return *this = *this * s;
   }
 
-  vec4 &operator*=(const vec4 &v) {
-    x *= v.x, y *= v.y, z *= v.z, w *= v.w;
-    return *this;
-  }
+  ANGEL_CONSTEXPR vec4 &operator*=(const vec4 &v) { return *this = *this * v; }
 
-  vec4 &operator/=(const GLfloat s) {
+  ANGEL_CONSTEXPR vec4 &operator/=(const GLfloat s) {
 #ifdef DEBUG
     if (std::fabs(s) < DivideByZeroTolerance) {
       std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
@@ -474,15 +543,47 @@ struct vec4 {
 //  Non-class vec4 Methods
 //
 
-inline GLfloat dot(const vec4 &u, const vec4 &v) {
-  return u.x * v.x + u.y * v.y + u.z * v.z + u.w + v.w;
+#ifdef ANGEL_SIMD
+//  sum of the four lanes, in every lane
+inline __m128 hsum(__m128 v) {
+  v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+#endif
+
+ANGEL_CONSTEXPR GLfloat dot(const vec4 &u, const vec4 &v) {
+#ifdef ANGEL_SIMD
+  if (!ANGEL_CONSTANT_EVALUATED()) {
+    return _mm_cvtss_f32(hsum(_mm_mul_ps(u.simd(), v.simd())));
+  }
+#endif
+  return u.x * v.x + u.y * v.y + u.z * v.z + u.w * v.w;
 }
 
 inline GLfloat length(const vec4 &v) { return std::sqrt(dot(v, v)); }
 
-inline vec4 normalize(const vec4 &v) { return v / length(v); }
+inline vec4 normalize(const vec4 &v) {
+#ifdef ANGEL_SIMD
+  __m128 m = v.simd();
+  return vec4(_mm_div_ps(m, _mm_sqrt_ps(hsum(_mm_mul_ps(m, m)))));
+#else
+  return v / length(v);
+#endif
+}
 
-inline vec3 cross(const vec4 &a, const vec4 &b) {
+ANGEL_CONSTEXPR vec3 cross(const vec4 &a, const vec4 &b) {
+#ifdef ANGEL_SIMD
+  if (!ANGEL_CONSTANT_EVALUATED()) {
+    // a * b.yzx - a.yzx * b is the cross product in zxy order
+    __m128 ma = a.simd();
+    __m128 mb = b.simd();
+    __m128 a_yzx = _mm_shuffle_ps(ma, ma, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(mb, mb, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(ma, b_yzx), _mm_mul_ps(a_yzx, mb));
+    vec4 r(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+    return vec3(r.x, r.y, r.z);
+  }
+#endif
   return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
               a.x * b.y - a.y * b.x);
 }
@@ -0,0 +1,134 @@
+/**
+ * @file ${FILE}
+ * @brief resumable, crash-safe film storage
+ * @license ${LICENSE}
+ *
+ **/
+#ifndef RAYTRACER_FILM_FILE_H
+#define RAYTRACER_FILM_FILE_H
+
+#include "film.h"
+#include "mapped-file.h"
+#include <cstring>
+#include <memory>
+
+namespace sls {
+
+/**
+ * @brief everything needed to decide whether a film file can be resumed and
+ * where the sample sequence picks up again. Samplers are counter based, so
+ * the seed and the number of finished passes are the whole sampler state.
+ */
+struct FilmFileHeader {
+  char magic[8];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  uint32_t subsamples;
+  uint32_t integrator;
+  uint32_t samples_done;
+  uint64_t seed;
+  char reserved[24];
+};
+
+static_assert(sizeof(FilmFileHeader) == 64, "film file header is 64 bytes");
+
+/**
+ * @brief a FilmAccumulator whose arrays live in a memory-mapped file.
+ * @detail Layout: header, then per-pixel sums, luminance second moments and
+ * sample counts. checkpoint() syncs the pixel data before publishing the
+ * new pass count, so the header never claims samples that aren't on disk.
+ * A pass interrupted by a crash leaves some pixels one sample ahead; their
+ * counts say so, and resumed passes skip them.
+ */
+class FilmFile final {
+public:
+  /**
+   * @brief maps `path` for a width * height film.
+   * @param resume continue an existing file rendered with the same settings
+   * instead of starting over
+   * @return nullptr if the file can't be mapped or doesn't match
+   */
+  static std::unique_ptr<FilmFile> open(std::string const &path, int width,
+                                        int height, uint32_t subsamples,
+                                        uint32_t integrator, uint64_t seed,
+                                        bool resume) {
+    auto self = std::unique_ptr<FilmFile>(new FilmFile());
+    auto const n_pixels = size_t(width) * height;
+    auto const size = sizeof(FilmFileHeader) +
+                      n_pixels * (sizeof(vec4) + sizeof(float) +
+                                  sizeof(uint32_t));
+
+    if (!self->file.open(path, size, resume)) {
+      return nullptr;
+    }
+
+    auto expected = FilmFileHeader();
+    std::memset(&expected, 0, sizeof(expected));
+    std::memcpy(expected.magic, "SLSFILM", 8);
+    expected.version = 1;
+    expected.width = width;
+    expected.height = height;
+    expected.subsamples = subsamples;
+    expected.integrator = integrator;
+    expected.seed = seed;
+
+    auto header = self->header();
+    if (resume && !self->file.created()) {
+      expected.samples_done = header->samples_done;
+      if (std::memcmp(header, &expected, sizeof(expected)) != 0) {
+        std::cerr << path << " was rendered with different settings\n";
+        return nullptr;
+      }
+    } else {
+      *header = expected;
+    }
+
+    auto pixels = self->file.data() + sizeof(FilmFileHeader);
+    auto sum = reinterpret_cast<vec4 *>(pixels);
+    auto sum_sq = reinterpret_cast<float *>(sum + n_pixels);
+    auto count = reinterpret_cast<uint32_t *>(sum_sq + n_pixels);
+    self->accumulator.reset(
+        new FilmAccumulator(width, height, sum, sum_sq, count));
+    return self;
+  }
+
+  FilmAccumulator &film() { return *accumulator; }
+
+  uint32_t samples_done() const { return header()->samples_done; }
+
+  /**
+   * @brief makes `samples_done` finished passes durable. Blocks until every
+   * pixel is on disk, so call it every few passes and flush() in between.
+   */
+  bool checkpoint(uint32_t samples_done) {
+    auto const header_size = sizeof(FilmFileHeader);
+    if (!file.sync(header_size, file.size() - header_size)) {
+      return false;
+    }
+    header()->samples_done = samples_done;
+    return file.sync(0, header_size);
+  }
+
+  /**
+   * @brief starts writing the pixel data back without waiting. The header
+   * is left alone, so a crash resumes from the last checkpoint.
+   */
+  bool flush() {
+    auto const header_size = sizeof(FilmFileHeader);
+    return file.flush(header_size, file.size() - header_size);
+  }
+
+private:
+  FilmFile() = default;
+
+  FilmFileHeader *header() const {
+    return reinterpret_cast<FilmFileHeader *>(file.data());
+  }
+
+  MappedFile file;
+  std::unique_ptr<FilmAccumulator> accumulator;
+};
+}
+
+#endif // RAYTRACER_FILM_FILE_H
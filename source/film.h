@@ -0,0 +1,212 @@
+/**
+ * @file ${FILE}
+ * @brief image reconstruction for the ray tracer
+ * @license ${LICENSE}
+ *
+ **/
+#ifndef RAYTRACER_FILM_H
+#define RAYTRACER_FILM_H
+
+#include "types.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace sls {
+
+enum FilterType { FilterBox = 0, FilterTent, FilterGaussian };
+
+/**
+ * @brief separable pixel reconstruction filter.
+ * @detail Offsets are in pixels relative to the pixel's sample position.
+ * Subsamples are weighted as they are traced and summed straight into
+ * their pixel, so no supersampled image is ever stored.
+ */
+struct ReconstructionFilter {
+  FilterType type = FilterBox;
+  float radius = 0.5;
+  // gaussian falloff
+  float alpha = 2.0;
+
+  static ReconstructionFilter box(float radius = 0.5) {
+    auto self = ReconstructionFilter();
+    self.radius = radius;
+    return self;
+  }
+
+  static ReconstructionFilter tent(float radius = 1.0) {
+    auto self = ReconstructionFilter();
+    self.type = FilterTent;
+    self.radius = radius;
+    return self;
+  }
+
+  static ReconstructionFilter gaussian(float radius = 1.5, float alpha = 2.0) {
+    auto self = ReconstructionFilter();
+    self.type = FilterGaussian;
+    self.radius = radius;
+    self.alpha = alpha;
+    return self;
+  }
+
+  float weight_1d(float x) const {
+    x = std::fabs(x);
+    if (x > radius) {
+      return 0.0;
+    }
+
+    switch (type) {
+    case FilterTent:
+      return 1.0f - x / radius;
+    case FilterGaussian:
+      // shifted so the weight reaches zero at the support edge
+      return std::exp(-alpha * x * x) - std::exp(-alpha * radius * radius);
+    case FilterBox:
+    default:
+      return 1.0;
+    }
+  }
+
+  float weight(vec2 const &offset) const {
+    return weight_1d(offset.x) * weight_1d(offset.y);
+  }
+
+  /**
+   * @brief jittered offset for subsample `index` of a strata * strata grid
+   * laid over the filter support
+   * @param u uniform random pair in [0, 1)
+   */
+  vec2 stratified_offset(int index, int strata, vec2 const &u) const {
+    auto const cell_x = float(index % strata);
+    auto const cell_y = float(index / strata);
+
+    auto const x = (cell_x + u.x) / float(strata);
+    auto const y = (cell_y + u.y) / float(strata);
+
+    return vec2((2.0f * x - 1.0f) * radius, (2.0f * y - 1.0f) * radius);
+  }
+};
+
+/**
+ * @brief linear HDR accumulation buffer.
+ * @detail Stores an unclamped running sum and a sample count per pixel.
+ * Adding a sample is a single add; averaging, clamping and quantization only
+ * happen when an output image is requested. The arrays are either owned or
+ * borrowed from external storage, such as a memory-mapped film file.
+ */
+struct FilmAccumulator {
+  int width;
+  int height;
+
+  vec4 *sum;
+  // luminance second moment, for noise estimates
+  float *sum_sq;
+  uint32_t *count;
+
+  FilmAccumulator(int width, int height)
+      : width(width), height(height), sum_storage(size_t(width) * height),
+        sum_sq_storage(size_t(width) * height, 0.0f),
+        count_storage(size_t(width) * height, 0) {
+    sum = sum_storage.data();
+    sum_sq = sum_sq_storage.data();
+    count = count_storage.data();
+  }
+
+  /**
+   * @brief accumulates into caller-owned arrays of width * height entries
+   */
+  FilmAccumulator(int width, int height, vec4 *sum, float *sum_sq,
+                  uint32_t *count)
+      : width(width), height(height), sum(sum), sum_sq(sum_sq), count(count) {
+  }
+
+  // moving keeps the owned arrays' addresses; copying would alias them
+  FilmAccumulator(FilmAccumulator &&) = default;
+  FilmAccumulator(FilmAccumulator const &) = delete;
+
+  size_t size() const { return size_t(width) * height; }
+
+  void clear() {
+    std::fill(sum, sum + size(), vec4(0.0, 0.0, 0.0, 0.0));
+    std::fill(sum_sq, sum_sq + size(), 0.0f);
+    std::fill(count, count + size(), 0u);
+  }
+
+  static float luminance(vec4 const &c) {
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+  }
+
+  void add(size_t idx, vec4 const &color) {
+    auto const y = luminance(color);
+    sum[idx] += color;
+    sum_sq[idx] += y * y;
+    ++count[idx];
+  }
+
+  /**
+   * @brief estimated RMS error of the image: the square root of the mean,
+   * over pixels, of the variance of each pixel's luminance mean
+   */
+  double estimated_rmse() const {
+    auto total = 0.0;
+    auto n_pixels = 0lu;
+
+    for (auto idx = 0lu; idx < size(); ++idx) {
+      auto const n = double(count[idx]);
+      if (n < 2.0) {
+        continue;
+      }
+
+      auto const mean_y = double(luminance(sum[idx])) / n;
+      auto const variance =
+          std::max(0.0, (sum_sq[idx] / n - mean_y * mean_y) * n / (n - 1.0));
+      total += variance / n;
+      ++n_pixels;
+    }
+
+    return n_pixels > 0 ? std::sqrt(total / n_pixels) : INFINITY;
+  }
+
+  vec4 mean(size_t idx) const {
+    return count[idx] > 0 ? sum[idx] / float(count[idx])
+                          : vec4(0.0, 0.0, 0.0, 0.0);
+  }
+
+  /**
+   * @brief per-pixel mean as linear float RGBA, unclamped
+   */
+  void resolve_rgba32f(std::vector<float> &out) const {
+    out.resize(size() * 4);
+    for (auto idx = 0lu; idx < size(); ++idx) {
+      auto const color = mean(idx);
+      auto buff = &out[idx * 4];
+      for (auto c = 0; c < 4; ++c) {
+        buff[c] = color[c];
+      }
+    }
+  }
+
+  /**
+   * @brief clamps the per-pixel mean to [0, 1] and rounds to 8-bit RGBA
+   */
+  void resolve_rgba8(std::vector<uint8_t> &out) const {
+    out.resize(size() * 4);
+    for (auto idx = 0lu; idx < size(); ++idx) {
+      auto const color = mean(idx);
+      auto buff = &out[idx * 4];
+      for (auto c = 0; c < 4; ++c) {
+        auto const v = std::min(std::max(color[c], 0.0f), 1.0f);
+        buff[c] = static_cast<uint8_t>(v * 255.0f + 0.5f);
+      }
+    }
+  }
+
+private:
+  std::vector<vec4> sum_storage;
+  std::vector<float> sum_sq_storage;
+  std::vector<uint32_t> count_storage;
+};
+}
+
+#endif // RAYTRACER_FILM_H
@@ -6,17 +6,1328 @@
  *
  **/
 #include "image-utils.h"
+#include <FreeImage.h>
+#include <ImfChannelList.h>
+#include <ImfOutputFile.h>
+#include <half.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <future>
+#include <mutex>
+#include <png.h>
+#include <thread>
+#include <zlib.h>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+void init_freeimage() {
+  static std::once_flag once;
+  std::call_once(once, []() { FreeImage_Initialise(); });
+}
+
+/**
+ * @brief whether the codec stores floating point pixels
+ */
+bool is_float_format(FREE_IMAGE_FORMAT fif) {
+  return fif == FIF_EXR || fif == FIF_HDR;
+}
+
+float to_float(uint8_t v) { return v * (1.0f / 255.0f); }
+float to_float(float v) { return v; }
+
+uint8_t to_byte(uint8_t v) { return v; }
+uint8_t to_byte(float v) {
+  return static_cast<uint8_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f +
+                              0.5f);
+}
+
+/**
+ * @brief exact linear to 8-bit sRGB encoding. A table indexed by the float's
+ * exponent and top 8 mantissa bits gives the code at the start of each bin;
+ * codes step by at most one inside a bin, so one comparison with the
+ * midpoint to the next code rounds every input exactly as
+ * round(255 * srgb(x)) would.
+ */
+class SrgbEncoder {
+public:
+  static SrgbEncoder const &get() {
+    static const SrgbEncoder encoder;
+    return encoder;
+  }
+
+  uint8_t encode(float x) const {
+    auto const b = bin(x);
+    return b < 0 ? 0 : fix_up(std::min(x, 1.0f), bins[b]);
+  }
+
+  /**
+   * @brief continuous code for x in [0, 1], linear between the midpoints
+   * around its exact code; used for dithering
+   */
+  float code(float x) const {
+    auto const c = encode(x);
+    auto const lo = c > 0 ? midpoint[c - 1] : 0.0f;
+    auto const hi = c < 255 ? midpoint[c] : 1.0f;
+    auto const lo_code = c > 0 ? c - 0.5f : 0.0f;
+    auto const hi_code = c < 255 ? c + 0.5f : 255.0f;
+    auto const t = hi > lo ? (std::min(std::max(x, 0.0f), 1.0f) - lo) /
+                                 (hi - lo)
+                           : 0.0f;
+    return lo_code + t * (hi_code - lo_code);
+  }
+
+#ifdef __SSE2__
+  /**
+   * @brief encodes four values: clamping and table indices in SSE, the
+   * lookups and fix-ups per lane
+   */
+  void encode4(__m128 x, uint8_t *out) const {
+    // max/min return the second operand for NaN, which maps it to 0
+    x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    auto idx = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x), 15),
+                             _mm_set1_epi32(int(first_bin)));
+    // below the first bin: bin 0, whose fix-up still gives 0; 1.0 is one
+    // past the last bin
+    idx = _mm_and_si128(idx, _mm_cmpgt_epi32(idx, _mm_set1_epi32(-1)));
+    auto const last = _mm_set1_epi32(n_bins - 1);
+    auto const over = _mm_cmpgt_epi32(idx, last);
+    idx = _mm_or_si128(_mm_and_si128(over, last), _mm_andnot_si128(over, idx));
+
+    alignas(16) float v[4];
+    alignas(16) int32_t i[4];
+    _mm_store_ps(v, x);
+    _mm_store_si128(reinterpret_cast<__m128i *>(i), idx);
+    for (auto k = 0; k < 4; ++k) {
+      out[k] = fix_up(v[k], bins[i[k]]);
+    }
+  }
+#endif
+
+private:
+  // bins cover [2^-13, 1); below that every value encodes to 0
+  static constexpr int first_exponent = -13;
+  static constexpr int n_bins = 13 * 256;
+
+  uint32_t first_bin;
+  uint8_t bins[n_bins];
+  // midpoint[c]: smallest float that rounds to c + 1
+  float midpoint[256];
+
+  static double srgb(double x) {
+    return x <= 0.0031308 ? 12.92 * x : 1.055 * std::pow(x, 1.0 / 2.4) - 0.055;
+  }
+
+  static uint32_t bits(float x) {
+    auto b = uint32_t();
+    std::memcpy(&b, &x, sizeof(b));
+    return b;
+  }
+
+  SrgbEncoder() {
+    first_bin = bits(std::ldexp(1.0f, first_exponent)) >> 15;
+    for (auto c = 0; c < 255; ++c) {
+      auto const s = (c + 0.5) / 255.0;
+      auto const x = s <= 0.04045 ? s / 12.92
+                                  : std::pow((s + 0.055) / 1.055, 2.4);
+      auto f = float(x);
+      if (double(f) < x) {
+        f = std::nextafter(f, 2.0f);
+      }
+      midpoint[c] = f;
+    }
+    midpoint[255] = INFINITY;
+
+    for (auto i = 0; i < n_bins; ++i) {
+      auto const start = (first_bin + uint32_t(i)) << 15;
+      auto x = 0.0f;
+      std::memcpy(&x, &start, sizeof(x));
+      bins[i] = uint8_t(std::lround(255.0 * srgb(x)));
+    }
+  }
+
+  int bin(float x) const {
+    if (!(x > 0.0f)) {
+      return -1;
+    }
+    auto const idx = int64_t(bits(std::min(x, 1.0f)) >> 15) - first_bin;
+    return idx < 0 ? -1 : int(std::min<int64_t>(idx, n_bins - 1));
+  }
+
+  uint8_t fix_up(float x, uint8_t c) const {
+    return uint8_t(c + (x >= midpoint[c]));
+  }
+};
+
+/**
+ * @brief 8x8 Bayer threshold in (0, 1) for pixel (x, y)
+ */
+inline float bayer8(int x, int y) {
+  static const uint8_t matrix[8][8] = {
+      {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26},
+      {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+      {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+      {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21}};
+  return (matrix[y & 7][x & 7] + 0.5f) / 64.0f;
+}
+
+/**
+ * @brief one row of linear float pixels to 8 bits. Colour channels are
+ * sRGB encoded or clamped linear, alpha (the last of 2 or 4 channels) is
+ * always linear. The dither threshold depends only on the pixel position,
+ * so any split of the image into tiles gives the same result.
+ */
+void quantize_row(const float *in, uint8_t *out, int width, int channels,
+                  int y, QuantizeOptions const &options) {
+  auto const &srgb = SrgbEncoder::get();
+  auto const alpha = (channels == 2 || channels == 4) ? channels - 1 : -1;
+  auto const n_values = width * channels;
+
+  if (options.dither) {
+    for (auto x = 0, i = 0; x < width; ++x) {
+      auto const threshold = bayer8(x, y);
+      for (auto c = 0; c < channels; ++c, ++i) {
+        if (c == alpha) {
+          out[i] = to_byte(in[i]);
+          continue;
+        }
+        auto const v = in[i] > 0.0f ? std::min(in[i], 1.0f) : 0.0f;
+        auto const code = options.srgb ? srgb.code(v) : v * 255.0f;
+        out[i] = uint8_t(std::min(code + threshold, 255.0f));
+      }
+    }
+    return;
+  }
+
+  if (!options.srgb) {
+    for (auto i = 0; i < n_values; ++i) {
+      out[i] = to_byte(in[i]);
+    }
+    return;
+  }
+
+  auto i = 0;
+#ifdef __SSE2__
+  if (channels == 4) {
+    for (; i < n_values; i += 4) {
+      srgb.encode4(_mm_loadu_ps(in + i), out + i);
+      out[i + 3] = to_byte(in[i + 3]);
+    }
+  }
+#endif
+  for (; i < n_values; ++i) {
+    out[i] = i % channels == alpha ? to_byte(in[i]) : srgb.encode(in[i]);
+  }
+}
+
+/**
+ * @brief a source row as 8-bit values; floats are quantized, 8-bit rows
+ * copied as they are
+ */
+void convert_row(const uint8_t *in, uint8_t *out, int width, int channels,
+                 int, QuantizeOptions const &) {
+  std::copy_n(in, size_t(width) * channels, out);
+}
+
+void convert_row(const float *in, uint8_t *out, int width, int channels,
+                 int y, QuantizeOptions const &quantize) {
+  quantize_row(in, out, width, channels, y, quantize);
+}
+
+/**
+ * @brief builds the bitmap the codec wants straight from the top-down
+ * source rows. Each row is flipped (FreeImage is bottom-up) and converted
+ * as it is copied, so the pixels are touched exactly once.
+ */
+template <typename T>
+FIBITMAP *make_bitmap(FREE_IMAGE_FORMAT fif, const T *src, int width,
+                      int height, int channels,
+                      QuantizeOptions const &quantize) {
+  auto const has_alpha = channels == 4 && fif != FIF_JPEG && fif != FIF_HDR;
+  auto const out_channels = has_alpha ? 4 : 3;
+
+  if (is_float_format(fif)) {
+    auto dib =
+        FreeImage_AllocateT(has_alpha ? FIT_RGBAF : FIT_RGBF, width, height);
+    if (!dib) {
+      return nullptr;
+    }
+
+    for (auto y = 0; y < height; ++y) {
+      auto in = src + size_t(height - 1 - y) * width * channels;
+      auto out = reinterpret_cast<float *>(FreeImage_GetScanLine(dib, y));
+      for (auto x = 0; x < width; ++x, in += channels, out += out_channels) {
+        for (auto c = 0; c < out_channels; ++c) {
+          out[c] = to_float(in[c < channels ? c : 0]);
+        }
+      }
+    }
+    return dib;
+  }
+
+  auto dib = FreeImage_Allocate(width, height, out_channels * 8);
+  if (!dib) {
+    return nullptr;
+  }
+
+  auto row = std::vector<uint8_t>(size_t(width) * channels);
+  for (auto y = 0; y < height; ++y) {
+    auto const src_y = height - 1 - y;
+    convert_row(src + size_t(src_y) * width * channels, &row[0], width,
+                channels, src_y, quantize);
+    auto in = &row[0];
+    auto out = FreeImage_GetScanLine(dib, y);
+    for (auto x = 0; x < width; ++x, in += channels, out += out_channels) {
+      auto const g = channels >= 3 ? in[1] : in[0];
+      auto const b = channels >= 3 ? in[2] : in[0];
+      out[FI_RGBA_RED] = in[0];
+      out[FI_RGBA_GREEN] = g;
+      out[FI_RGBA_BLUE] = b;
+      if (has_alpha) {
+        out[FI_RGBA_ALPHA] = in[3];
+      }
+    }
+  }
+  return dib;
+}
+
+/**
+ * @brief per-format save flags
+ */
+int save_flags(FREE_IMAGE_FORMAT fif, ExrOptions const &exr) {
+  switch (fif) {
+  case FIF_JPEG:
+    return JPEG_QUALITYSUPERB;
+  case FIF_TIFF:
+    return TIFF_DEFLATE;
+  case FIF_EXR: {
+    static const int compression[] = {EXR_ZIP, EXR_PIZ, EXR_PXR24, EXR_B44,
+                                      EXR_NONE};
+    return compression[exr.compression] | (exr.half_float ? 0 : EXR_FLOAT);
+  }
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief the name an output is written under until it is complete
+ */
+std::string temp_file_name(std::string const &filename) {
+  return filename + ".part";
+}
+
+/**
+ * @brief moves a finished temp file over filename, or drops it if writing
+ * failed, so the previous image survives a failed or interrupted write
+ * @return whether filename now holds the new image
+ */
+bool commit_temp_file(std::string const &filename, bool ok) {
+  auto const temp = temp_file_name(filename);
+  if (ok) {
+#ifdef _WIN32
+    // rename won't replace an existing file on Windows
+    std::remove(filename.c_str());
+#endif
+    ok = std::rename(temp.c_str(), filename.c_str()) == 0;
+  }
+  if (!ok) {
+    std::remove(temp.c_str());
+  }
+  return ok;
+}
+
+/**
+ * @brief writes filename through write(FILE *) into its temp file, then
+ * moves it into place
+ */
+template <typename FN_T>
+bool replace_file(std::string const &filename, FN_T write) {
+  auto file = std::fopen(temp_file_name(filename).c_str(), "wb");
+  auto ok = file && write(file);
+  if (file) {
+    ok = std::fclose(file) == 0 && ok;
+  }
+  return commit_temp_file(filename, ok);
+}
+
+template <typename T>
+bool write_png(const char *filename, const T *src, int width, int height,
+               int channels, PngOptions const &png,
+               QuantizeOptions const &quantize);
+
+/**
+ * @brief converts, encodes and writes the image, reporting encode time and
+ * file size
+ */
+template <typename T>
+bool write_pixels(const char *filename, const T *Src, int Width, int Height,
+                  int channels, ExrOptions const &exr, PngOptions const &png,
+                  QuantizeOptions const &quantize) {
+  using clock = std::chrono::steady_clock;
+
+  if (!filename || !Src || Width <= 0 || Height <= 0 || channels < 1 ||
+      channels > 4) {
+    return false;
+  }
+
+  init_freeimage();
+
+  auto fif = FreeImage_GetFIFFromFilename(filename);
+  if (fif == FIF_UNKNOWN || !FreeImage_FIFSupportsWriting(fif)) {
+    std::cerr << "write_image: unsupported output format " << filename
+              << "\n";
+    return false;
+  }
+
+  // libpng directly, for control over deflate and row filtering
+  if (fif == FIF_PNG) {
+    return write_png(filename, Src, Width, Height, channels, png, quantize);
+  }
+
+  auto const t_start = clock::now();
+
+  auto dib = make_bitmap(fif, Src, Width, Height, channels, quantize);
+  if (!dib) {
+    std::cerr << "write_image: could not allocate " << Width << "x" << Height
+              << " bitmap\n";
+    return false;
+  }
+
+  // encode to memory first so the byte count is exact; the file goes
+  // through a temp file so a failed write never truncates the previous one
+  auto mem = FreeImage_OpenMemory();
+  auto ok = FreeImage_SaveToMemory(fif, dib, mem, save_flags(fif, exr)) != 0;
+  FreeImage_Unload(dib);
+
+  auto const t_encoded = clock::now();
+
+  BYTE *data = nullptr;
+  DWORD n_bytes = 0;
+  if (ok) {
+    ok = FreeImage_AcquireMemory(mem, &data, &n_bytes) != 0;
+  }
+
+  if (ok) {
+    ok = replace_file(filename, [&](FILE *file) {
+      return std::fwrite(data, 1, n_bytes, file) == n_bytes;
+    });
+  }
+  FreeImage_CloseMemory(mem);
+
+  if (!ok) {
+    std::cerr << "write_image: failed to write " << filename << "\n";
+    return false;
+  }
+
+  auto const encode_ms =
+      std::chrono::duration<double, std::milli>(t_encoded - t_start).count();
+  std::cout << "wrote " << filename << ": " << n_bytes << " bytes, encoded in "
+            << encode_ms << " ms\n";
+  return true;
+}
+}
 
 bool write_image(const char *filename, const unsigned char *Src, int Width,
                  int Height, int channels) {
+  return write_pixels(filename, Src, Width, Height, channels, ExrOptions(),
+                      PngOptions(), QuantizeOptions());
+}
 
-  
+bool write_image(const std::string &filename, const uint8_t *src, int width,
+                 int height, int channels, PngOptions const &png) {
+  return write_pixels(filename.c_str(), src, width, height, channels,
+                      ExrOptions(), png, QuantizeOptions());
+}
 
-  return false;
+bool write_image(const std::string &filename, const float *src, int width,
+                 int height, int channels, ExrOptions const &exr,
+                 PngOptions const &png, QuantizeOptions const &quantize) {
+  return write_pixels(filename.c_str(), src, width, height, channels, exr,
+                      png, quantize);
 }
 
-bool write_image(const std::string &filename, const uint8_t *src, int width,
-                 int height, int channels) {
-  return write_image(filename.c_str(), src, width, height, channels);
+bool is_float_image(const std::string &filename) {
+  init_freeimage();
+  return is_float_format(FreeImage_GetFIFFromFilename(filename.c_str()));
+}
+
+//---------------------------------streaming
+//encoders---------------------------------------
+
+namespace {
+
+using encode_clock = std::chrono::steady_clock;
+
+/**
+ * @brief bookkeeping shared by the streaming encoders: rows written and
+ * time spent encoding them
+ */
+class StripWriterBase : public ScanlineWriter {
+protected:
+  std::string filename;
+  int width;
+  int height;
+  int rows_written = 0;
+  double encode_seconds = 0.0;
+
+  StripWriterBase(const std::string &filename, int width, int height)
+      : filename(filename), width(width), height(height) {}
+
+  // encoders own open files and library state
+  StripWriterBase(StripWriterBase const &) = delete;
+  StripWriterBase &operator=(StripWriterBase const &) = delete;
+
+  void add_time(encode_clock::time_point start) {
+    encode_seconds +=
+        std::chrono::duration<double>(encode_clock::now() - start).count();
+  }
+
+  bool report(bool ok) const {
+    if (!ok || rows_written != height) {
+      std::cerr << "write_image: failed to stream " << filename << " ("
+                << rows_written << " of " << height << " rows)\n";
+      return false;
+    }
+
+    auto file = std::ifstream(filename, std::ios::binary | std::ios::ate);
+    std::cout << "wrote " << filename << ": " << file.tellg()
+              << " bytes, encoded in " << encode_seconds * 1000.0
+              << " ms\n";
+    return true;
+  }
+};
+
+/**
+ * @brief libpng row encoder. Rows go to a ".part" file next to the output,
+ * which replaces it only once the image is complete, so a failed or
+ * interrupted encode never truncates the previous file.
+ */
+class PngStripWriter final : public StripWriterBase {
+  PngOptions options;
+  QuantizeOptions quantize;
+  int channels;
+  FILE *file = nullptr;
+  png_structp png = nullptr;
+  png_infop info = nullptr;
+  std::vector<png_byte> row;
+
+public:
+  PngStripWriter(const std::string &filename, int width, int height,
+                 PngOptions const &options, QuantizeOptions const &quantize,
+                 int channels = 4)
+      : StripWriterBase(filename, width, height), options(options),
+        quantize(quantize), channels(channels),
+        row(size_t(width) * channels) {}
+
+  ~PngStripWriter() override {
+    if (png) {
+      png_destroy_write_struct(&png, &info);
+    }
+    if (file) {
+      std::fclose(file);
+      std::remove(temp_file_name(filename).c_str());
+    }
+  }
+
+  bool open() {
+    static const int color_type[] = {PNG_COLOR_TYPE_GRAY,
+                                     PNG_COLOR_TYPE_GRAY_ALPHA,
+                                     PNG_COLOR_TYPE_RGB,
+                                     PNG_COLOR_TYPE_RGB_ALPHA};
+    static const int strategy[] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE,
+                                   Z_HUFFMAN_ONLY};
+    static const int filter[] = {PNG_ALL_FILTERS, PNG_FILTER_NONE,
+                                 PNG_FILTER_SUB, PNG_FILTER_UP,
+                                 PNG_FILTER_PAETH};
+
+    file = std::fopen(temp_file_name(filename).c_str(), "wb");
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr,
+                                  nullptr);
+    info = png ? png_create_info_struct(png) : nullptr;
+    if (!file || !info) {
+      return false;
+    }
+    // setjmp may only be a whole condition; libpng errors land here
+    if (setjmp(png_jmpbuf(png))) {
+      return false;
+    }
+
+    png_init_io(png, file);
+    png_set_compression_level(png, std::min(std::max(options.level, 0), 9));
+    png_set_compression_strategy(png, strategy[options.strategy]);
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, filter[options.filter]);
+    png_set_IHDR(png, info, width, height, 8, color_type[channels - 1],
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    return true;
+  }
+
+  /**
+   * @brief rows of width * channels values; floats are quantized to 8 bits
+   * as they are copied into the row buffer
+   */
+  template <typename T> bool write_values(const T *values, int n_rows) {
+    auto const start = encode_clock::now();
+    if (setjmp(png_jmpbuf(png))) {
+      return false;
+    }
+
+    auto const row_size = width * channels;
+    for (auto y = 0; y < n_rows && rows_written < height; ++y) {
+      convert_row(values + size_t(y) * row_size, &row[0], width, channels,
+                  rows_written, quantize);
+      png_write_row(png, &row[0]);
+      ++rows_written;
+    }
+    add_time(start);
+    return true;
+  }
+
+  bool write_rows(const float *rgba, int n_rows) override {
+    return write_values(rgba, n_rows);
+  }
+
+  bool close() override {
+    auto const complete = rows_written == height;
+    if (complete) {
+      if (setjmp(png_jmpbuf(png))) {
+        return finish(false);
+      }
+      png_write_end(png, info);
+    }
+    return finish(complete);
+  }
+
+private:
+  /**
+   * @brief releases libpng and the file, moves a complete image into place
+   * and reports
+   */
+  bool finish(bool ok) {
+    png_destroy_write_struct(&png, &info);
+    png = nullptr;
+
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return report(commit_temp_file(filename, ok));
+  }
+};
+
+/**
+ * @brief OpenEXR scanline encoder; like PngStripWriter it writes a ".part"
+ * file and only replaces the output once every row is in
+ */
+class ExrStripWriter final : public StripWriterBase {
+  ExrOptions options;
+  std::unique_ptr<Imf::OutputFile> file;
+  std::vector<half> half_rows;
+
+public:
+  ExrStripWriter(const std::string &filename, int width, int height,
+                 ExrOptions const &options)
+      : StripWriterBase(filename, width, height), options(options) {}
+
+  ~ExrStripWriter() override {
+    if (file) {
+      close_file();
+      std::remove(temp_file_name(filename).c_str());
+    }
+  }
+
+  bool open() {
+    static const Imf::Compression compression[] = {
+        Imf::ZIP_COMPRESSION, Imf::PIZ_COMPRESSION, Imf::PXR24_COMPRESSION,
+        Imf::B44_COMPRESSION, Imf::NO_COMPRESSION};
+
+    auto header = Imf::Header(width, height);
+    header.compression() = compression[options.compression];
+
+    auto const type = options.half_float ? Imf::HALF : Imf::FLOAT;
+    for (auto name : {"R", "G", "B", "A"}) {
+      header.channels().insert(name, Imf::Channel(type));
+    }
+
+    try {
+      file.reset(
+          new Imf::OutputFile(temp_file_name(filename).c_str(), header));
+    } catch (std::exception const &e) {
+      std::cerr << "write_image: " << e.what() << "\n";
+      return false;
+    }
+    return true;
+  }
+
+  bool write_rows(const float *rgba, int n_rows) override {
+    auto const start = encode_clock::now();
+    n_rows = std::min(n_rows, height - rows_written);
+
+    // OpenEXR 1.x won't convert between slice and channel types
+    auto const n_values = size_t(n_rows) * width * 4;
+    auto pixels = reinterpret_cast<const char *>(rgba);
+    if (options.half_float) {
+      half_rows.resize(n_values);
+      std::copy(rgba, rgba + n_values, half_rows.begin());
+      pixels = reinterpret_cast<const char *>(&half_rows[0]);
+    }
+
+    // the slices address the whole image; only rows of this strip are read
+    auto const type = options.half_float ? Imf::HALF : Imf::FLOAT;
+    auto const value_size = options.half_float ? sizeof(half) : sizeof(float);
+    auto const x_stride = value_size * 4;
+    auto const y_stride = x_stride * width;
+    auto base = const_cast<char *>(pixels) - rows_written * y_stride;
+
+    auto frame = Imf::FrameBuffer();
+    auto channel = 0;
+    for (auto name : {"R", "G", "B", "A"}) {
+      frame.insert(name, Imf::Slice(type, base + value_size * channel++,
+                                    x_stride, y_stride));
+    }
+
+    try {
+      // block compression runs on the IlmThread pool
+      file->setFrameBuffer(frame);
+      file->writePixels(n_rows);
+    } catch (std::exception const &e) {
+      std::cerr << "write_image: " << e.what() << "\n";
+      return false;
+    }
+
+    rows_written += n_rows;
+    add_time(start);
+    return true;
+  }
+
+  bool close() override {
+    auto const start = encode_clock::now();
+    auto const ok = close_file() && rows_written == height;
+    add_time(start);
+    return report(commit_temp_file(filename, ok));
+  }
+
+private:
+  /**
+   * @brief flushes and closes the file; OpenEXR reports write errors by
+   * throwing
+   */
+  bool close_file() {
+    try {
+      file.reset();
+    } catch (std::exception const &e) {
+      std::cerr << "write_image: " << e.what() << "\n";
+      file.release();
+      return false;
+    }
+    return true;
+  }
+};
+
+template <typename WRITER_T, typename... ARGS_T>
+std::unique_ptr<ScanlineWriter> open_writer(ARGS_T &&... args) {
+  auto writer = std::unique_ptr<WRITER_T>(
+      new WRITER_T(std::forward<ARGS_T>(args)...));
+  if (!writer->open()) {
+    return nullptr;
+  }
+  return std::move(writer);
+}
+
+//---------------------------------parallel
+//deflate---------------------------------------
+
+/**
+ * @brief PNG filter type bytes, as stored at the start of each row
+ */
+enum PngFilterByte : uint8_t {
+  FilterByteNone = 0,
+  FilterByteSub,
+  FilterByteUp,
+  FilterByteAverage,
+  FilterBytePaeth,
+};
+
+inline uint8_t paeth_predictor(int a, int b, int c) {
+  auto const p = a + b - c;
+  auto const pa = std::abs(p - a);
+  auto const pb = std::abs(p - b);
+  auto const pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return uint8_t(a);
+  }
+  return uint8_t(pb <= pc ? b : c);
+}
+
+/**
+ * @brief residual of byte i of a row under filter `type`
+ */
+inline uint8_t filter_byte(int type, const uint8_t *row, const uint8_t *prev,
+                           size_t i, int bpp) {
+  auto const x = row[i];
+  auto const a = i >= size_t(bpp) ? row[i - bpp] : 0;
+  auto const b = prev[i];
+  auto const c = i >= size_t(bpp) ? prev[i - bpp] : 0;
+
+  switch (type) {
+  case FilterByteSub:
+    return uint8_t(x - a);
+  case FilterByteUp:
+    return uint8_t(x - b);
+  case FilterByteAverage:
+    return uint8_t(x - ((a + b) >> 1));
+  case FilterBytePaeth:
+    return uint8_t(x - paeth_predictor(a, b, c));
+  default:
+    return x;
+  }
+}
+
+/**
+ * @brief writes the filter byte and filtered row to out. Adaptive filtering
+ * picks the filter with the smallest sum of absolute residuals, as libpng
+ * does.
+ */
+void filter_png_row(const uint8_t *row, const uint8_t *prev, size_t n,
+                    int bpp, PngRowFilter filter, uint8_t *out) {
+  static const int fixed[] = {FilterByteNone, FilterByteNone, FilterByteSub,
+                              FilterByteUp, FilterBytePaeth};
+
+  auto type = fixed[filter];
+  if (filter == PngFilterAdaptive) {
+    auto best_cost = ~0lu;
+    for (auto t = int(FilterByteNone); t <= int(FilterBytePaeth); ++t) {
+      auto cost = 0lu;
+      for (auto i = 0lu; i < n && cost < best_cost; ++i) {
+        cost += std::abs(int(int8_t(filter_byte(t, row, prev, i, bpp))));
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        type = t;
+      }
+    }
+  }
+
+  out[0] = uint8_t(type);
+  for (auto i = 0lu; i < n; ++i) {
+    out[i + 1] = filter_byte(type, row, prev, i, bpp);
+  }
+}
+
+/**
+ * @brief one independently deflated slice of the filtered image
+ */
+struct DeflatePiece {
+  std::vector<uint8_t> data;
+  uLong adler = 0;
+  uLong crc = 0;
+  size_t in_size = 0;
+};
+
+/**
+ * @brief raw deflate of [begin, end) primed with the preceding 32 KiB, so
+ * matches can reach back across the chunk boundary. All but the last chunk
+ * end on a full flush: byte aligned, no final block, ready to concatenate.
+ */
+bool deflate_piece(const uint8_t *data, size_t begin, size_t end, bool last,
+                   PngOptions const &options, DeflatePiece &piece) {
+  static const int strategy[] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE,
+                                 Z_HUFFMAN_ONLY};
+  auto const window = size_t(1) << 15;
+
+  auto strm = z_stream();
+  auto const level = std::min(std::max(options.level, 0), 9);
+  if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8,
+                   strategy[options.strategy]) != Z_OK) {
+    return false;
+  }
+
+  if (begin > 0) {
+    auto const dict = std::min(begin, window);
+    deflateSetDictionary(&strm, data + begin - dict, uInt(dict));
+  }
+
+  piece.in_size = end - begin;
+  piece.data.resize(deflateBound(&strm, uLong(piece.in_size)) + 64);
+
+  strm.next_in = const_cast<Bytef *>(data + begin);
+  strm.avail_in = uInt(piece.in_size);
+  strm.next_out = &piece.data[0];
+  strm.avail_out = uInt(piece.data.size());
+
+  auto const status = deflate(&strm, last ? Z_FINISH : Z_FULL_FLUSH);
+  auto const ok = (last ? status == Z_STREAM_END : status == Z_OK) &&
+                  strm.avail_in == 0;
+  piece.data.resize(piece.data.size() - strm.avail_out);
+  deflateEnd(&strm);
+
+  piece.adler = adler32(adler32(0, Z_NULL, 0), data + begin,
+                        uInt(piece.in_size));
+  piece.crc = crc32(crc32(0, Z_NULL, 0), &piece.data[0],
+                    uInt(piece.data.size()));
+  return ok;
+}
+
+void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+  out.push_back(uint8_t(v >> 24));
+  out.push_back(uint8_t(v >> 16));
+  out.push_back(uint8_t(v >> 8));
+  out.push_back(uint8_t(v));
+}
+
+/**
+ * @brief runs fn(index) for index in [0, count) on up to n_threads workers
+ */
+template <typename FN_T> void parallel_for(size_t count, int n_threads, FN_T fn) {
+  std::atomic<size_t> next(0);
+  auto workers = std::vector<std::future<void>>();
+  for (auto t = 0; t < n_threads; ++t) {
+    workers.push_back(std::async(std::launch::async, [&]() {
+      for (auto i = next++; i < count; i = next++) {
+        fn(i);
+      }
+    }));
+  }
+  for (auto &worker : workers) {
+    worker.get();
+  }
+}
+
+/**
+ * @brief pigz-style PNG encoder: rows are filtered and 128 KiB chunks
+ * deflated on all threads, then stitched into one zlib stream in a single
+ * IDAT. The Adler-32 and chunk CRC are combined from the per-chunk sums
+ * instead of rescanning the data.
+ */
+template <typename T>
+bool write_png_parallel(const char *filename, const T *src, int width,
+                        int height, int channels, PngOptions const &options,
+                        QuantizeOptions const &quantize, int n_threads) {
+  static const uint8_t color_type[] = {0, 4, 2, 6};
+  static const uint8_t signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+  auto const t_start = encode_clock::now();
+  auto const row_values = size_t(width) * channels;
+  auto const row_size = row_values + 1;
+
+  // filter every row; a row only depends on its own and the previous
+  // source row, so bands of rows are independent
+  auto filtered = std::vector<uint8_t>(row_size * height);
+  auto const band_rows = size_t(64);
+  auto const n_bands = (size_t(height) + band_rows - 1) / band_rows;
+  parallel_for(n_bands, n_threads, [&](size_t band) {
+    auto prev = std::vector<uint8_t>(row_values, 0);
+    auto row = std::vector<uint8_t>(row_values);
+    auto const y0 = band * band_rows;
+    auto const y1 = std::min(y0 + band_rows, size_t(height));
+
+    if (y0 > 0) {
+      convert_row(src + (y0 - 1) * row_values, &prev[0], width, channels,
+                  int(y0 - 1), quantize);
+    }
+    for (auto y = y0; y < y1; ++y) {
+      convert_row(src + y * row_values, &row[0], width, channels, int(y),
+                  quantize);
+      filter_png_row(&row[0], &prev[0], row_values, channels, options.filter,
+                     &filtered[y * row_size]);
+      std::swap(row, prev);
+    }
+  });
+
+  // deflate whole-row chunks of at least 128 KiB
+  auto const chunk_rows = std::max(size_t(1), ((size_t(1) << 17) + row_size -
+                                               1) / row_size);
+  auto const n_chunks = (size_t(height) + chunk_rows - 1) / chunk_rows;
+  auto pieces = std::vector<DeflatePiece>(n_chunks);
+  std::atomic<bool> failed(false);
+  parallel_for(n_chunks, n_threads, [&](size_t k) {
+    auto const begin = k * chunk_rows * row_size;
+    auto const end = std::min((k + 1) * chunk_rows, size_t(height)) * row_size;
+    if (!deflate_piece(&filtered[0], begin, end, k + 1 == n_chunks, options,
+                       pieces[k])) {
+      failed = true;
+    }
+  });
+  if (failed) {
+    std::cerr << "write_image: deflate failed for " << filename << "\n";
+    return false;
+  }
+
+  // zlib header for this level, then the combined checksums
+  auto const level = std::min(std::max(options.level, 0), 9);
+  auto const level_flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  auto zlib_header = (0x78u << 8) | (level_flags << 6);
+  zlib_header += 31 - zlib_header % 31;
+
+  auto adler = pieces[0].adler;
+  auto idat_size = size_t(2 + 4);
+  for (auto k = 0lu; k < n_chunks; ++k) {
+    if (k > 0) {
+      adler = adler32_combine(adler, pieces[k].adler, pieces[k].in_size);
+    }
+    idat_size += pieces[k].data.size();
+  }
+
+  auto head = std::vector<uint8_t>();
+  head.insert(head.end(), signature, signature + 8);
+  put_u32(head, 13);
+  auto const ihdr = head.size();
+  head.insert(head.end(), {'I', 'H', 'D', 'R'});
+  put_u32(head, uint32_t(width));
+  put_u32(head, uint32_t(height));
+  head.insert(head.end(), {8, color_type[channels - 1], 0, 0, 0});
+  put_u32(head, uint32_t(crc32(0, &head[ihdr], uInt(head.size() - ihdr))));
+
+  put_u32(head, uint32_t(idat_size));
+  auto const idat = head.size();
+  head.insert(head.end(), {'I', 'D', 'A', 'T'});
+  head.push_back(uint8_t(zlib_header >> 8));
+  head.push_back(uint8_t(zlib_header));
+  auto crc = crc32(0, &head[idat], uInt(head.size() - idat));
+  for (auto const &piece : pieces) {
+    crc = crc32_combine(crc, piece.crc, piece.data.size());
+  }
+
+  auto tail = std::vector<uint8_t>();
+  put_u32(tail, uint32_t(adler));
+  crc = crc32(crc, &tail[0], 4);
+  put_u32(tail, uint32_t(crc));
+  put_u32(tail, 0);
+  auto const iend = tail.size();
+  tail.insert(tail.end(), {'I', 'E', 'N', 'D'});
+  put_u32(tail, uint32_t(crc32(0, &tail[iend], 4)));
+
+  auto const t_encoded = encode_clock::now();
+
+  auto const ok = replace_file(filename, [&](FILE *file) {
+    auto ok = std::fwrite(&head[0], 1, head.size(), file) == head.size();
+    for (auto const &piece : pieces) {
+      ok = ok && std::fwrite(&piece.data[0], 1, piece.data.size(), file) ==
+                     piece.data.size();
+    }
+    return ok && std::fwrite(&tail[0], 1, tail.size(), file) == tail.size();
+  });
+
+  if (!ok) {
+    std::cerr << "write_image: failed to write " << filename << "\n";
+    return false;
+  }
+
+  auto const encode_ms =
+      std::chrono::duration<double, std::milli>(t_encoded - t_start).count();
+  std::cout << "wrote " << filename << ": "
+            << head.size() + idat_size - 6 + tail.size()
+            << " bytes, encoded in " << encode_ms << " ms on " << n_threads
+            << " threads\n";
+  return true;
+}
+
+template <typename T>
+bool write_png(const char *filename, const T *src, int width, int height,
+               int channels, PngOptions const &png,
+               QuantizeOptions const &quantize) {
+  auto n_threads = png.threads > 0
+                       ? png.threads
+                       : int(std::max(1u, std::thread::hardware_concurrency()));
+  if (n_threads > 1 && size_t(width) * channels * height > (size_t(1) << 18)) {
+    return write_png_parallel(filename, src, width, height, channels, png,
+                              quantize, n_threads);
+  }
+
+  PngStripWriter writer(filename, width, height, png, quantize, channels);
+  if (!writer.open()) {
+    std::cerr << "write_image: failed to write " << filename << "\n";
+    return false;
+  }
+  return writer.write_values(src, height) && writer.close();
+}
+
+/**
+ * @brief ACES filmic curve (Narkowicz's fit): a toe, a near-linear middle
+ * and a shoulder that rolls highlights off towards white
+ */
+inline float filmic(float x) {
+  x = std::max(x, 0.0f);
+  return std::min(x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f),
+                  1.0f);
+}
+
+/**
+ * @brief runs one of FreeImage's operators. FreeImage is bottom-up and
+ * wants RGBF, so rows are flipped on the way in and out; the copies run in
+ * parallel, and of the operators only Fattal02 splits its own work by rows.
+ * @return false if FreeImage could not map the image
+ */
+bool tone_map_freeimage(const float *rgba, int width, int height,
+                        ToneMapOptions const &options, int n_threads,
+                        std::vector<uint8_t> &out) {
+  init_freeimage();
+  auto hdr = FreeImage_AllocateT(FIT_RGBF, width, height);
+  if (!hdr) {
+    return false;
+  }
+
+  parallel_for(size_t(height), n_threads, [&](size_t y) {
+    auto dst = reinterpret_cast<FIRGBF *>(
+        FreeImage_GetScanLine(hdr, int(height - 1 - y)));
+    auto src = rgba + y * width * 4;
+    for (auto x = 0; x < width; ++x) {
+      // the operators take logs of luminance; keep them off negatives
+      dst[x].red = std::max(src[x * 4 + 0], 0.0f);
+      dst[x].green = std::max(src[x * 4 + 1], 0.0f);
+      dst[x].blue = std::max(src[x * 4 + 2], 0.0f);
+    }
+  });
+
+  FIBITMAP *ldr = nullptr;
+  switch (options.op) {
+  case ToneReinhard05:
+    ldr = FreeImage_TmoReinhard05Ex(hdr, options.intensity, options.contrast,
+                                    options.adaptation,
+                                    options.color_correction);
+    break;
+  case ToneDrago03:
+    ldr = FreeImage_TmoDrago03(hdr, options.gamma, options.drago_exposure);
+    break;
+  case ToneFattal02:
+    ldr = FreeImage_TmoFattal02(hdr, options.saturation, options.attenuation);
+    break;
+  default:
+    break;
+  }
+  FreeImage_Unload(hdr);
+  if (!ldr) {
+    return false;
+  }
+
+  auto const bytes_pp = int(FreeImage_GetBPP(ldr) / 8);
+  parallel_for(size_t(height), n_threads, [&](size_t y) {
+    auto src = FreeImage_GetScanLine(ldr, int(height - 1 - y));
+    auto alpha = rgba + y * width * 4 + 3;
+    auto dst = &out[y * width * 4];
+    for (auto x = 0; x < width; ++x) {
+      dst[x * 4 + 0] = src[x * bytes_pp + FI_RGBA_RED];
+      dst[x * 4 + 1] = src[x * bytes_pp + FI_RGBA_GREEN];
+      dst[x * 4 + 2] = src[x * bytes_pp + FI_RGBA_BLUE];
+      dst[x * 4 + 3] = to_byte(alpha[x * 4]);
+    }
+  });
+  FreeImage_Unload(ldr);
+  return true;
+}
+}
+
+bool is_streamable(const std::string &filename) {
+  init_freeimage();
+  auto const fif = FreeImage_GetFIFFromFilename(filename.c_str());
+  return fif == FIF_PNG || fif == FIF_EXR;
+}
+
+std::unique_ptr<ScanlineWriter>
+open_scanline_writer(const std::string &filename, int width, int height,
+                     ExrOptions const &exr, PngOptions const &png,
+                     QuantizeOptions const &quantize) {
+  init_freeimage();
+
+  switch (FreeImage_GetFIFFromFilename(filename.c_str())) {
+  case FIF_PNG:
+    return open_writer<PngStripWriter>(filename, width, height, png,
+                                       quantize);
+  case FIF_EXR:
+    return open_writer<ExrStripWriter>(filename, width, height, exr);
+  default:
+    return nullptr;
+  }
+}
+
+namespace {
+
+int thread_count(int threads) {
+  return threads > 0 ? threads
+                     : int(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+/**
+ * @brief runs fn(y) for every row, in tiles of rows spread over the threads
+ */
+template <typename FN_T>
+void parallel_rows(int height, int n_threads, FN_T fn) {
+  auto const tile_rows = 32;
+  auto const n_tiles = size_t(height + tile_rows - 1) / tile_rows;
+  parallel_for(n_tiles, n_threads, [&](size_t tile) {
+    auto const y1 = std::min(int(tile + 1) * tile_rows, height);
+    for (auto y = int(tile) * tile_rows; y < y1; ++y) {
+      fn(y);
+    }
+  });
+}
+}
+
+void quantize_rgba8(const float *rgba, int width, int height,
+                    QuantizeOptions const &options, std::vector<uint8_t> &out,
+                    int threads) {
+  out.resize(size_t(width) * height * 4);
+  parallel_rows(height, thread_count(threads), [&](int y) {
+    auto const offset = size_t(y) * width * 4;
+    quantize_row(rgba + offset, &out[offset], width, 4, y, options);
+  });
+}
+
+void tone_map(const float *rgba, int width, int height,
+              ToneMapOptions const &options, std::vector<uint8_t> &out) {
+  static const char *names[] = {"clamp", "filmic", "reinhard05", "drago03",
+                                "fattal02"};
+  auto const t_start = std::chrono::steady_clock::now();
+  auto const n_threads = thread_count(options.threads);
+  out.resize(size_t(width) * height * 4);
+
+  auto op = options.op;
+  if ((op == ToneReinhard05 || op == ToneDrago03 || op == ToneFattal02) &&
+      !tone_map_freeimage(rgba, width, height, options, n_threads, out)) {
+    std::cerr << "tone_map: " << names[op] << " failed, clamping\n";
+    op = ToneClamp;
+  }
+
+  if (op == ToneClamp && options.exposure == 0.0f) {
+    quantize_rgba8(rgba, width, height, options.quantize, out, n_threads);
+  } else if (op == ToneClamp || op == ToneFilmic) {
+    auto const scale = std::exp2(options.exposure);
+    parallel_rows(height, n_threads, [&](int y) {
+      auto const offset = size_t(y) * width * 4;
+      auto src = rgba + offset;
+      auto mapped = std::vector<float>(src, src + width * 4);
+      for (auto x = 0; x < width * 4; x += 4) {
+        for (auto c = 0; c < 3; ++c) {
+          auto const v = mapped[x + c] * scale;
+          mapped[x + c] = op == ToneFilmic ? filmic(v) : v;
+        }
+      }
+      quantize_row(&mapped[0], &out[offset], width, 4, y, options.quantize);
+    });
+  }
+
+  auto const ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - t_start)
+                      .count();
+  std::cout << "tone mapped (" << names[op] << ") in " << ms << " ms on "
+            << n_threads << " threads\n";
+}
+
+bool write_thumbnail(const std::string &filename, const float *rgba,
+                     int width, int height, int max_size,
+                     ToneMapOptions const &tone) {
+  init_freeimage();
+  auto const scale = std::min(1.0, double(max_size) / std::max(width, height));
+  auto const thumb_width = std::max(1, int(width * scale + 0.5));
+  auto const thumb_height = std::max(1, int(height * scale + 0.5));
+
+  auto dib = make_bitmap(FIF_EXR, rgba, width, height, 4, tone.quantize);
+  auto thumb = dib ? FreeImage_Rescale(dib, thumb_width, thumb_height,
+                                       FILTER_BSPLINE)
+                   : nullptr;
+  FreeImage_Unload(dib);
+  if (!thumb) {
+    std::cerr << "write_thumbnail: could not scale to " << thumb_width << "x"
+              << thumb_height << "\n";
+    return false;
+  }
+
+  auto pixels = std::vector<float>(size_t(thumb_width) * thumb_height * 4);
+  for (auto y = 0; y < thumb_height; ++y) {
+    auto row = FreeImage_GetScanLine(thumb, thumb_height - 1 - y);
+    std::copy_n(reinterpret_cast<const float *>(row), thumb_width * 4,
+                &pixels[size_t(y) * thumb_width * 4]);
+  }
+  FreeImage_Unload(thumb);
+
+  auto bytes = std::vector<uint8_t>();
+  tone_map(&pixels[0], thumb_width, thumb_height, tone, bytes);
+  return write_image(filename, &bytes[0], thumb_width, thumb_height, 4);
+}
+
+namespace {
+
+class TiffPageWriter final : public PageWriter {
+  std::string filename;
+  FIMULTIBITMAP *pages = nullptr;
+  int n_pages = 0;
+
+public:
+  explicit TiffPageWriter(const std::string &filename) : filename(filename) {}
+
+  ~TiffPageWriter() { close(); }
+
+  bool open() {
+    // the page cache lives in a file next to the output, not in memory
+    pages = FreeImage_OpenMultiBitmap(FIF_TIFF, filename.c_str(), TRUE, FALSE,
+                                      FALSE);
+    if (!pages) {
+      std::cerr << "could not create " << filename << "\n";
+    }
+    return pages != nullptr;
+  }
+
+  bool append(const uint8_t *rgba, int width, int height) override {
+    auto dib = make_bitmap(FIF_TIFF, rgba, width, height, 4,
+                           QuantizeOptions());
+    if (!pages || !dib) {
+      FreeImage_Unload(dib);
+      return false;
+    }
+    // AppendPage reports nothing; a page that didn't land leaves the count
+    auto const before = FreeImage_GetPageCount(pages);
+    FreeImage_AppendPage(pages, dib);
+    FreeImage_Unload(dib);
+    if (FreeImage_GetPageCount(pages) != before + 1) {
+      std::cerr << "could not append page " << n_pages << " to " << filename
+                << "\n";
+      return false;
+    }
+    ++n_pages;
+    return true;
+  }
+
+  bool close() override {
+    if (!pages) {
+      return false;
+    }
+    auto const t_start = std::chrono::steady_clock::now();
+    auto const ok = FreeImage_CloseMultiBitmap(pages, TIFF_DEFLATE) != 0;
+    pages = nullptr;
+    auto const ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - t_start)
+                        .count();
+    if (!ok) {
+      std::cerr << "write_image: failed to write " << filename << "\n";
+      return false;
+    }
+    std::cout << "wrote " << filename << ": " << n_pages << " pages in " << ms
+              << " ms\n";
+    return true;
+  }
+};
+}
+
+std::unique_ptr<PageWriter> open_multipage_writer(const std::string &filename) {
+  init_freeimage();
+  if (FreeImage_GetFIFFromFilename(filename.c_str()) != FIF_TIFF) {
+    return nullptr;
+  }
+
+  auto writer = std::unique_ptr<TiffPageWriter>(new TiffPageWriter(filename));
+  if (!writer->open()) {
+    return nullptr;
+  }
+  return std::move(writer);
 }
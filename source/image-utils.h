@@ -8,12 +8,235 @@
 #ifndef RAYTRACER_IMAGE_UTILS_H
 #define RAYTRACER_IMAGE_UTILS_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+enum ExrCompression {
+  ExrZip = 0,
+  ExrPiz,
+  ExrPxr24,
+  ExrB44,
+  ExrNone,
+};
+
+/**
+ * @brief OpenEXR settings for float output. Half floats halve the file size
+ * and keep ~3 significant digits, which is plenty for display.
+ */
+struct ExrOptions {
+  bool half_float = true;
+  ExrCompression compression = ExrZip;
+};
+
+enum PngStrategy {
+  PngStrategyDefault = 0,
+  PngStrategyFiltered,
+  PngStrategyRle,
+  PngStrategyHuffmanOnly,
+};
+
+enum PngRowFilter {
+  PngFilterAdaptive = 0,
+  PngFilterNone,
+  PngFilterSub,
+  PngFilterUp,
+  PngFilterPaeth,
+};
+
+/**
+ * @brief zlib and row filter settings for PNG output.
+ * @detail Adaptive filtering tries all five filters per row and deflate at
+ * level 9 searches hardest; both buy a smaller file with encode time.
+ */
+struct PngOptions {
+  int level = 6;
+  PngStrategy strategy = PngStrategyDefault;
+  PngRowFilter filter = PngFilterAdaptive;
+  // deflate threads for whole images; 0 uses every core, 1 keeps libpng
+  int threads = 0;
+
+  /**
+   * @brief for checkpoints: one cheap filter, run-length matching only
+   */
+  static PngOptions fast() {
+    auto self = PngOptions();
+    self.level = 1;
+    self.strategy = PngStrategyRle;
+    self.filter = PngFilterSub;
+    return self;
+  }
+
+  /**
+   * @brief for the final frame
+   */
+  static PngOptions small() {
+    auto self = PngOptions();
+    self.level = 9;
+    self.strategy = PngStrategyFiltered;
+    return self;
+  }
+};
+
+/**
+ * @brief how linear values in [0, 1] become 8-bit codes. sRGB encoding is
+ * exact: every value rounds to the nearest code. Dithering adds an ordered
+ * 8x8 threshold per pixel, trading banding in smooth gradients for fine
+ * noise.
+ */
+struct QuantizeOptions {
+  bool srgb = true;
+  bool dither = false;
+};
+
+enum ToneOperator {
+  ToneClamp = 0,
+  ToneFilmic,
+  ToneReinhard05,
+  ToneDrago03,
+  ToneFattal02,
+};
+
+/**
+ * @brief maps linear radiance to display values once, on the final image.
+ * @detail Clamp keeps the old look and clips highlights; filmic is a
+ * per-pixel ACES-style curve; the Reinhard05 and Drago03 operators come
+ * from FreeImage and adapt to the image's luminance. Fattal02, also from
+ * FreeImage, is local: it compresses large gradients and solves a Poisson
+ * equation for the result, keeping detail in both shadows and highlights.
+ */
+struct ToneMapOptions {
+  ToneOperator op = ToneClamp;
+  // stops applied before the curve (clamp, filmic)
+  float exposure = 0.0f;
+
+  // Reinhard05: intensity in [-8, 8], contrast in [0.3, 1), 0 picks one from
+  // the image; light adaptation and color correction in [0, 1]
+  double intensity = 0.0;
+  double contrast = 0.0;
+  double adaptation = 1.0;
+  double color_correction = 0.0;
+
+  // Drago03: display gamma and exposure in stops
+  double gamma = 2.2;
+  double drago_exposure = 0.0;
+
+  // Fattal02: color saturation in [0.4, 0.6], attenuation in [0.8, 0.9]
+  double saturation = 0.5;
+  double attenuation = 0.85;
+
+  // encoding of the clamp and filmic results
+  QuantizeOptions quantize;
+
+  // rows are mapped on this many threads; 0 uses every core
+  int threads = 0;
+};
+
+/**
+ * @brief linear float RGBA to 8-bit RGBA in parallel tiles of rows; alpha
+ * stays linear
+ */
+void quantize_rgba8(const float *rgba, int width, int height,
+                    QuantizeOptions const &options, std::vector<uint8_t> &out,
+                    int threads = 0);
+
+/**
+ * @brief tone maps linear float RGBA to 8-bit RGBA; alpha is clamped
+ */
+void tone_map(const float *rgba, int width, int height,
+              ToneMapOptions const &options, std::vector<uint8_t> &out);
 
 bool write_image(const char *filename, const unsigned char *Src, int Width,
                  int Height, int channels);
 
 bool write_image(const std::string &filename, const uint8_t *src, int width,
-                 int height, int channels);
+                 int height, int channels,
+                 PngOptions const &png = PngOptions());
+
+/**
+ * @brief writes linear float pixels, unclamped for EXR/HDR; 8-bit formats
+ * are clamped to [0, 1] and quantized as `quantize` says
+ */
+bool write_image(const std::string &filename, const float *src, int width,
+                 int height, int channels,
+                 ExrOptions const &exr = ExrOptions(),
+                 PngOptions const &png = PngOptions(),
+                 QuantizeOptions const &quantize = QuantizeOptions());
+
+/**
+ * @brief writes a preview of linear float RGBA scaled down to max_size pixels
+ * on its long side, then tone mapped. The downsampling runs in linear light
+ * with FreeImage's B-spline filter, which has no negative lobes to ring
+ * around bright highlights.
+ */
+bool write_thumbnail(const std::string &filename, const float *rgba,
+                     int width, int height, int max_size,
+                     ToneMapOptions const &tone = ToneMapOptions());
+
+/**
+ * @brief whether the file extension names a floating point format
+ */
+bool is_float_image(const std::string &filename);
+
+/**
+ * @brief incremental encoder for bounded-memory output: linear float RGBA
+ * rows are handed over top to bottom in strips, encoded straight away and
+ * never held for the whole image.
+ */
+class ScanlineWriter {
+public:
+  virtual ~ScanlineWriter() = default;
+
+  /**
+   * @brief encodes the next n_rows rows of width * 4 floats
+   */
+  virtual bool write_rows(const float *rgba, int n_rows) = 0;
+
+  /**
+   * @brief finishes the file; reports encode time and bytes written
+   */
+  virtual bool close() = 0;
+};
+
+/**
+ * @brief whether open_scanline_writer supports the format of filename (PNG
+ * or EXR)
+ */
+bool is_streamable(const std::string &filename);
+
+/**
+ * @brief opens a streaming encoder for PNG or EXR, chosen from the file
+ * extension
+ * @param quantize how PNG rows become 8 bits
+ * @return nullptr if the format can't be streamed or the file can't be
+ * created
+ */
+std::unique_ptr<ScanlineWriter>
+open_scanline_writer(const std::string &filename, int width, int height,
+                     ExrOptions const &exr = ExrOptions(),
+                     PngOptions const &png = PngOptions(),
+                     QuantizeOptions const &quantize = QuantizeOptions());
+
+/**
+ * @brief appends 8-bit RGBA frames to one multipage file, e.g. an animation
+ * sequence. Pages are compressed into FreeImage's page cache as they arrive;
+ * close() writes the file.
+ */
+class PageWriter {
+public:
+  virtual ~PageWriter() = default;
+
+  virtual bool append(const uint8_t *rgba, int width, int height) = 0;
+
+  virtual bool close() = 0;
+};
+
+/**
+ * @brief opens a multipage TIFF for writing
+ * @return nullptr if the format has no multipage support or the file can't
+ * be created
+ */
+std::unique_ptr<PageWriter> open_multipage_writer(const std::string &filename);
 
 #endif // RAYTRACER_IMAGE_UTILS_H
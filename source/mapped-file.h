@@ -0,0 +1,148 @@
+/**
+ * @file ${FILE}
+ * @brief memory-mapped files for crash-safe render state
+ * @license ${LICENSE}
+ *
+ **/
+#ifndef RAYTRACER_MAPPED_FILE_H
+#define RAYTRACER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sls {
+
+/**
+ * @brief a file mapped read/write and shared, so stores land in the page
+ * cache and survive a crash of the process; sync() makes them durable.
+ * @detail POSIX only; on other platforms open() always fails and callers
+ * fall back to in-memory state.
+ */
+class MappedFile final {
+public:
+  MappedFile() = default;
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  ~MappedFile() { close(); }
+
+  /**
+   * @brief maps `size` bytes of `path`.
+   * @param keep_contents map an existing file of exactly `size` bytes as is;
+   * otherwise (or if the file is empty) it is created or truncated and zero
+   * filled
+   */
+  bool open(std::string const &path, size_t size, bool keep_contents) {
+    close();
+#ifndef _WIN32
+    auto const flags = O_RDWR | O_CREAT | (keep_contents ? 0 : O_TRUNC);
+    fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+      std::cerr << "could not open " << path << "\n";
+      return false;
+    }
+
+    // an empty file (e.g. just created) has no contents to keep
+    struct stat info;
+    fresh = !keep_contents || (fstat(fd, &info) == 0 && info.st_size == 0);
+    if (!fresh && (fstat(fd, &info) != 0 || size_t(info.st_size) != size)) {
+      std::cerr << path << " does not match this render\n";
+      close();
+      return false;
+    }
+
+    if (fresh && ftruncate(fd, off_t(size)) != 0) {
+      std::cerr << "could not size " << path << "\n";
+      close();
+      return false;
+    }
+
+    auto addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      std::cerr << "could not map " << path << "\n";
+      close();
+      return false;
+    }
+
+    bytes = static_cast<char *>(addr);
+    length = size;
+    return true;
+#else
+    std::cerr << "memory-mapped film files need POSIX mmap\n";
+    return false;
+#endif
+  }
+
+  /**
+   * @brief blocks until [offset, offset + size) is on disk
+   */
+  bool sync(size_t offset, size_t size) {
+#ifndef _WIN32
+    return write_back(offset, size, MS_SYNC);
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * @brief starts writing [offset, offset + size) to disk and returns
+   * without waiting, so a later sync() has less left to do
+   */
+  bool flush(size_t offset, size_t size) {
+#ifndef _WIN32
+    return write_back(offset, size, MS_ASYNC);
+#else
+    return false;
+#endif
+  }
+
+  bool sync() { return sync(0, length); }
+
+  void close() {
+#ifndef _WIN32
+    if (bytes) {
+      munmap(bytes, length);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif
+    bytes = nullptr;
+    length = 0;
+    fd = -1;
+  }
+
+  char *data() const { return bytes; }
+  size_t size() const { return length; }
+
+  /**
+   * @brief whether open() started from an empty file
+   */
+  bool created() const { return fresh; }
+
+private:
+#ifndef _WIN32
+  bool write_back(size_t offset, size_t size, int flags) {
+    // msync wants a page-aligned start
+    auto const page = size_t(sysconf(_SC_PAGESIZE));
+    auto const begin = offset / page * page;
+    return bytes && msync(bytes + begin, offset + size - begin, flags) == 0;
+  }
+#endif
+
+  int fd = -1;
+  bool fresh = false;
+  char *bytes = nullptr;
+  size_t length = 0;
+};
+}
+
+#endif // RAYTRACER_MAPPED_FILE_H
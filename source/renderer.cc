@@ -13,6 +13,18 @@
 namespace sls {
 
 using namespace ::std;
+
+Ray PixelCamera::ray(double x, double y) const {
+  auto const fx = float(x);
+  auto const fy = float(y);
+
+  auto start = near_origin + fx * near_dx + fy * near_dy;
+  auto end = far_origin + fx * far_dx + fy * far_dy;
+  start.w = 1.0;
+
+  return Ray(start, vec4(normalize(xyz(end - start)), 0.0));
+}
+
 CommandLineArgs parse_args(int argc, char const **argv) {
   using namespace std;
   assert(argc >= 0);
@@ -21,14 +33,103 @@ CommandLineArgs parse_args(int argc, char const **argv) {
   args.argv.reserve(size_t(argc));
 
   for (auto i = 0lu; i < argc; ++i) {
-    if (argv[i][0] != '\0') {
-      args.argv.push_back(string(argv[i]));
+    auto arg = string(argv[i]);
+    if (arg.empty()) {
+      continue;
+    }
+
+    // --name=value (or bare --name) options go to named_args
+    if (arg.compare(0, 2, "--") == 0) {
+      auto eq = arg.find('=');
+      auto name = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+      auto value = eq == string::npos ? string() : arg.substr(eq + 1);
+      args.named_args[name] = value;
+    } else {
+      args.argv.push_back(arg);
     }
   }
 
   return args;
 }
 
+bool find_nearest_hit(Scene const &scene, Ray const &ray, SceneHit &hit) {
+  auto hit_found = false;
+  auto const data = RayData(ray);
+
+  for (auto const &obj : scene.objects) {
+    if ((obj->target & TargetRayTracer) != TargetRayTracer) {
+      continue;
+    }
+
+    // only the closest hit so far needs a normal
+    auto t = obj->intersect_t(data);
+    if (t < 0 || (hit_found && t >= hit.inter.t)) {
+      continue;
+    }
+
+    auto intersection = obj->intersect(ray);
+    if (intersection.t < 0) {
+      continue;
+    }
+
+    hit_found = true;
+    hit.obj = obj;
+    hit.inter = intersection;
+  }
+
+  if (hit_found) {
+    hit.point = ray.start + hit.inter.t * ray.dir;
+  }
+  return hit_found;
+}
+
+bool segment_unblocked(Scene const &scene, vec4 const &origin, vec3 const &dir,
+                       double max_t) {
+  auto const ray = RayData(Ray(origin, vec4(dir, 0.0)));
+
+  for (auto const &obj : scene.objects) {
+    if ((obj->target & TargetRayTracer) != TargetRayTracer) {
+      continue;
+    }
+
+    auto t = obj->intersect_t(ray);
+    if (t > 1e-6 && t < max_t) {
+      return false;
+    }
+  }
+  return true;
+}
+
+vec4 reflection_weight(Material const &mtl, size_t n_lights) {
+  // phong highlights are scaled by pow(.) / 10 per light
+  auto const k = mtl.k_reflective + mtl.k_specular * 0.1f * float(n_lights);
+  return k * mtl.specular;
+}
+
+vec4 transmission_weight(Material const &mtl) {
+  return mtl.k_transmittance * mtl.color;
+}
+
+float branch_survival(vec4 const &weight, size_t depth, PathConfig const &cf,
+                      Sampler &sampler, RayStats &stats) {
+  auto const w = max_rgb(weight);
+  if (w < cf.min_contribution) {
+    stats.culled.fetch_add(1, memory_order_relaxed);
+    return 0.0;
+  }
+
+  if (depth < cf.roulette_depth) {
+    return 1.0;
+  }
+
+  auto const survival = std::min(w, 1.0f);
+  if (sampler.next_1d() >= survival) {
+    stats.roulette.fetch_add(1, memory_order_relaxed);
+    return 0.0;
+  }
+  return survival;
+}
+
 bool shadow_ray_unblocked(sls::Scene const &scene,
                           std::shared_ptr<sls::SceneObject> obj,
                           vec4 const &light_pos, vec4 const &intersect_point) {
@@ -40,7 +141,7 @@ bool shadow_ray_unblocked(sls::Scene const &scene,
   dir.w = 0.0;
   dir = normalize(dir);
 
-  auto shadow_ray = Ray{intersect_point, dir};
+  auto const shadow_ray = RayData(Ray{intersect_point, dir});
   for (auto const &i : scene.objects) {
     auto can_shadow =
         ((i->target & sls::TargetRayTracer) == sls::TargetRayTracer);
@@ -63,7 +164,8 @@ vec3 reflected_ray(sls::Scene scene, Angel::vec4 const &vec4,
 vec4 shade_ray_intersection(Scene const &scene,
                             std::shared_ptr<SceneObject> obj,
                             vec4 const &intersect_point, vec3 normal_sceneview,
-                            vec4 env_reflection, vec4 env_refraction) {
+                            vec4 env_reflection, vec4 env_refraction,
+                            Sampler &sampler) {
   using namespace Angel;
 
   auto color = vec4(0.0, 0.0, 0.0, 1.0);
@@ -80,7 +182,8 @@ vec4 shade_ray_intersection(Scene const &scene,
     auto n_lights = scene.n_lights();
 
     for (auto i = 0; i < n_lights; ++i) {
-      auto light_location = scene.light_locations[i];
+      // fresh point on the light for every shading point
+      auto light_location = scene.sample_light_location(i, sampler);
       auto const &l_color = scene.light_colors[i];
 
       auto l_pos = vec3();
@@ -121,7 +224,7 @@ vec4 shade_ray_intersection(Scene const &scene,
 
       auto spec_product = mtl.k_specular * env_reflection * mtl.specular;
 
-      auto specular = clamp(ks * (spec_product), 0.0, 1.0);
+      auto specular = ks * spec_product;
 
       if (dot(l_pos, normal) < 0.0) {
         specular = vec4(0.0, 0.0, 0.0, 1.0);
@@ -140,7 +243,7 @@ vec4 shade_ray_intersection(Scene const &scene,
   color += refraction + reflective;
   color.w = mtl.color.w;
 
-  return clamp(color, 0.0, 1.0);
+  return color;
 }
 
 Ray get_reflection_ray(vec3 const &intersection, vec3 const &incident,
@@ -167,4 +270,267 @@ Ray get_refraction_ray(vec3 intersection, vec3 const &incident,
 
   return res;
 }
+
+//---------------------------------path
+//tracing---------------------------------------
+
+/**
+ * @brief material lobes for the path tracer with their selection
+ * probabilities
+ */
+struct PathBsdf {
+  vec3 diffuse;
+  vec3 glossy;
+  vec3 mirror;
+  vec3 transmit;
+  float shininess;
+
+  float p_diffuse = 0.0;
+  float p_glossy = 0.0;
+  float p_mirror = 0.0;
+  float p_transmit = 0.0;
+
+  explicit PathBsdf(Material const &mtl)
+      : diffuse(mtl.k_diffuse * xyz(mtl.color)),
+        glossy(mtl.k_specular * xyz(mtl.specular)),
+        mirror(mtl.k_reflective * xyz(mtl.specular)),
+        transmit(mtl.k_transmittance * xyz(mtl.color)),
+        shininess(mtl.shininess) {
+    auto total = max_rgb(diffuse) + max_rgb(glossy) + max_rgb(mirror) +
+                 max_rgb(transmit);
+    if (total <= 0.0f) {
+      return;
+    }
+
+    // whitted materials may reflect more than they receive
+    if (total > 1.0f) {
+      diffuse /= total;
+      glossy /= total;
+      mirror /= total;
+      transmit /= total;
+      total = 1.0f;
+    }
+
+    p_diffuse = max_rgb(diffuse) / total;
+    p_glossy = max_rgb(glossy) / total;
+    p_mirror = max_rgb(mirror) / total;
+    p_transmit = max_rgb(transmit) / total;
+  }
+
+  bool has_smooth_lobes() const { return p_diffuse + p_glossy > 0.0f; }
+
+  /**
+   * @brief f(wo, wi) cos(theta_i) of the non-delta lobes
+   * @param pdf solid angle pdf of sampling wi, including lobe selection
+   */
+  vec3 eval(vec3 const &n, vec3 const &wo, vec3 const &wi, float &pdf) const {
+    pdf = 0.0;
+    auto const cos_i = dot(n, wi);
+    if (cos_i <= 0.0f) {
+      return vec3(0.0);
+    }
+
+    auto f = diffuse * float(M_1_PI);
+    pdf += p_diffuse * cos_i * float(M_1_PI);
+
+    if (p_glossy > 0.0f) {
+      auto const mirror_dir = 2.0f * dot(n, wo) * n - wo;
+      auto const lobe = std::pow(fmax(dot(mirror_dir, wi), 0.0), shininess);
+      f += glossy * ((shininess + 2.0f) * float(0.5 * M_1_PI) * lobe);
+      pdf += p_glossy * (shininess + 1.0f) * float(0.5 * M_1_PI) * lobe;
+    }
+
+    return f * cos_i;
+  }
+};
+
+static float power_heuristic(float pdf_a, float pdf_b) {
+  auto const a2 = pdf_a * pdf_a;
+  auto const b2 = pdf_b * pdf_b;
+  return (a2 + b2) > 0.0f ? a2 / (a2 + b2) : 0.0f;
+}
+
+static vec3 light_intensity(Scene const &scene, size_t i) {
+  return float(M_PI) * xyz(scene.light_colors[i].diffuse_color);
+}
+
+/**
+ * @brief solid angle pdf of sample_light_location producing the point at
+ * distance dist along wi
+ */
+static float light_pdf(Scene const &scene, size_t i, float dist,
+                       vec3 const &wi, vec3 const &light_n) {
+  auto const cos_l = dot(light_n, -wi);
+  if (cos_l <= 0.0f) {
+    return 0.0;
+  }
+  return dist * dist / (cos_l * scene.light_area(i));
+}
+
+/**
+ * @brief next-event estimate of direct lighting at a surface point
+ */
+static vec3 sample_direct(Scene const &scene, vec4 const &point,
+                          vec3 const &n, vec3 const &wo, PathBsdf const &bsdf,
+                          Sampler &sampler) {
+  auto result = vec3(0.0);
+  auto const origin = point + vec4(1e-4f * n, 0.0);
+
+  for (auto i = 0lu; i < scene.n_lights(); ++i) {
+    auto const location = scene.sample_light_location(i, sampler);
+
+    auto wi = vec3();
+    auto dist = INFINITY;
+    auto incident = vec3();
+    auto pdf_light = 0.0f; // stays 0 for delta lights
+
+    if (location.w == 0.0) {
+      wi = normalize(xyz(location));
+      incident = light_intensity(scene, i);
+    } else {
+      auto const to_light = xyz(location - point);
+      dist = length(to_light);
+      wi = to_light / dist;
+
+      if (scene.is_area_light(i)) {
+        auto const light_n = scene.light_normal(i, xyz(location));
+        pdf_light = light_pdf(scene, i, dist, wi, light_n);
+        if (pdf_light <= 0.0f) {
+          continue;
+        }
+        auto const emitted = light_intensity(scene, i) / scene.light_area(i);
+        incident = emitted / pdf_light;
+      } else {
+        incident = light_intensity(scene, i) / (dist * dist);
+      }
+    }
+
+    auto pdf_bsdf = 0.0f;
+    auto const f = bsdf.eval(n, wo, wi, pdf_bsdf);
+    if (max_rgb(f) <= 0.0f ||
+        !segment_unblocked(scene, origin, wi, dist - 1e-4)) {
+      continue;
+    }
+
+    auto const weight =
+        pdf_light > 0.0f ? power_heuristic(pdf_light, pdf_bsdf) : 1.0f;
+    result += weight * f * incident;
+  }
+
+  return result;
+}
+
+vec4 trace_path(Scene const &scene, Ray ray, Sampler &sampler,
+                PathConfig const &cf, RayStats &stats) {
+  auto radiance = vec3(0.0);
+  auto throughput = vec3(1.0);
+  auto alpha = 0.0f;
+
+  // camera rays and delta bounces see emitters without MIS
+  auto delta_bounce = true;
+  auto pdf_bsdf = 0.0f;
+
+  for (auto depth = 0lu; depth <= cf.max_bounces; ++depth) {
+    stats.traced.fetch_add(1, memory_order_relaxed);
+
+    auto hit = SceneHit();
+    auto const hit_found = find_nearest_hit(scene, ray, hit);
+    auto const max_t = hit_found ? hit.inter.t : INFINITY;
+
+    auto light = 0lu;
+    auto light_t = 0.0;
+    if (scene.intersect_light(ray, max_t, light, light_t)) {
+      auto const wi = xyz(ray.dir);
+      auto const light_point = xyz(ray.start + float(light_t) * ray.dir);
+      auto const light_n = scene.light_normal(light, light_point);
+
+      if (dot(light_n, wi) < 0.0f) {
+        auto weight = 1.0f;
+        if (!delta_bounce) {
+          auto const pdf_l = light_pdf(scene, light, float(light_t), wi,
+                                       light_n);
+          weight = power_heuristic(pdf_bsdf, pdf_l);
+        }
+        auto const emitted =
+            light_intensity(scene, light) / scene.light_area(light);
+        radiance += weight * throughput * emitted;
+      }
+
+      alpha = depth == 0 ? 1.0f : alpha;
+      break;
+    }
+
+    if (!hit_found) {
+      break;
+    }
+
+    auto const &mtl = hit.obj->material;
+    if (depth == 0) {
+      alpha = mtl.color.w;
+    }
+
+    auto const wo = -normalize(xyz(ray.dir));
+    auto const normal = normalize(hit.inter.normal);
+    auto const front_face = dot(normal, wo) >= 0.0f;
+    auto const n = front_face ? normal : -normal;
+
+    auto const bsdf = PathBsdf(mtl);
+    if (bsdf.has_smooth_lobes()) {
+      radiance +=
+          throughput * sample_direct(scene, hit.point, n, wo, bsdf, sampler);
+    }
+
+    auto wi = vec3();
+    auto lobe = sampler.next_1d();
+    auto const dir_u = sampler.next_2d();
+
+    if (lobe < bsdf.p_mirror) {
+      wi = 2.0f * dot(n, wo) * n - wo;
+      throughput *= bsdf.mirror / bsdf.p_mirror;
+      delta_bounce = true;
+    } else if ((lobe -= bsdf.p_mirror) < bsdf.p_transmit) {
+      auto const eta =
+          front_face ? scene.space_k_refraction / mtl.k_refraction
+                     : mtl.k_refraction / scene.space_k_refraction;
+      wi = refract(-wo, n, eta);
+      if (isnan(wi.x)) { // total internal reflection
+        wi = 2.0f * dot(n, wo) * n - wo;
+      }
+      wi = normalize(wi);
+      throughput *= bsdf.transmit / bsdf.p_transmit;
+      delta_bounce = true;
+    } else if ((lobe -= bsdf.p_transmit) <
+               bsdf.p_diffuse + bsdf.p_glossy) {
+      if (lobe < bsdf.p_diffuse) {
+        wi = from_local_frame(n, sample_cosine_hemisphere(dir_u));
+      } else {
+        auto const mirror_dir = 2.0f * dot(n, wo) * n - wo;
+        wi = from_local_frame(mirror_dir,
+                              sample_phong_lobe(dir_u, bsdf.shininess));
+      }
+
+      auto const f = bsdf.eval(n, wo, wi, pdf_bsdf);
+      if (pdf_bsdf <= 0.0f) {
+        break;
+      }
+      throughput *= f / pdf_bsdf;
+      delta_bounce = false;
+    } else { // absorbed
+      break;
+    }
+
+    auto const survival = branch_survival(vec4(throughput, 1.0), depth + 1,
+                                          cf, sampler, stats);
+    if (survival <= 0.0f) {
+      break;
+    }
+    throughput /= survival;
+
+    // leave the surface on the side the new direction points to
+    auto const side = dot(wi, n) >= 0.0f ? n : -n;
+    ray = Ray(hit.point + vec4(1e-4f * side, 0.0), vec4(wi, 0.0));
+  }
+
+  return vec4(radiance, alpha);
+}
 }
@@ -11,14 +11,104 @@
 #include "scene.h"
 #include "types.h"
 #include <assert.h>
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
 
 namespace sls {
 
+/**
+ * @brief generates primary rays at fractional pixel coordinates.
+ * @detail Unprojected near/far plane points are affine in window
+ * coordinates, so the points at pixels (0, 0), (1, 0) and (0, 1) describe
+ * every ray of the image without a gluUnProject per subsample.
+ */
+struct PixelCamera {
+  vec4 near_origin;
+  vec4 near_dx;
+  vec4 near_dy;
+
+  vec4 far_origin;
+  vec4 far_dx;
+  vec4 far_dy;
+
+  Ray ray(double x, double y) const;
+};
+
+enum Integrator {
+  IntegratorWhitted = 0, // phong shading plus mirror and refraction rays
+  IntegratorPath,        // monte carlo path tracing
+};
+
+/**
+ * @brief limits on how much of the ray tree is explored
+ */
+struct PathConfig {
+  // branches whose throughput falls below this are not traced
+  float min_contribution = 1e-3;
+  // from this depth on, paths are ended by russian roulette
+  size_t roulette_depth = 3;
+  // hard bounce limit for IntegratorPath
+  size_t max_bounces = 16;
+};
+
+/**
+ * @brief rays traced versus rays avoided, shared by all workers
+ */
+struct RayStats {
+  std::atomic<uint64_t> traced{0};
+  std::atomic<uint64_t> culled{0};
+  std::atomic<uint64_t> roulette{0};
+
+  void reset() {
+    traced = 0;
+    culled = 0;
+    roulette = 0;
+  }
+};
+
+/**
+ * @brief closest ray tracer target along a ray
+ */
+struct SceneHit {
+  std::shared_ptr<SceneObject> obj;
+  Intersection inter;
+  vec4 point;
+};
+
 CommandLineArgs parse_args(int argc, char const **argv);
 
+bool find_nearest_hit(Scene const &scene, Ray const &ray, SceneHit &hit);
+
+/**
+ * @brief true if nothing blocks the segment [origin, origin + dir * max_t]
+ */
+bool segment_unblocked(Scene const &scene, vec4 const &origin, vec3 const &dir,
+                       double max_t);
+
+/**
+ * @brief upper bound on the fraction of a reflection ray's radiance that
+ * shade_ray_intersection passes on (mirror plus phong highlight)
+ */
+vec4 reflection_weight(Material const &mtl, size_t n_lights);
+
+/**
+ * @brief fraction of a refraction ray's radiance passed on
+ */
+vec4 transmission_weight(Material const &mtl);
+
+/**
+ * @brief decides whether a branch with path throughput `weight` is traced.
+ * @detail Branches below cf.min_contribution are culled. Past
+ * cf.roulette_depth the branch survives with probability
+ * max_rgb(weight); the caller divides its radiance by the returned
+ * probability so the estimate stays unbiased.
+ * @return survival probability, or 0 if the branch is not traced
+ */
+float branch_survival(vec4 const &weight, size_t depth, PathConfig const &cf,
+                      Sampler &sampler, RayStats &stats);
+
 bool shadow_ray_unblocked(sls::Scene const &scene,
                           std::shared_ptr<sls::SceneObject> obj,
                           vec4 const &light_pos, vec4 const &intersect_point);
@@ -30,13 +120,26 @@ Angel::vec3 reflected_ray(sls::Scene scene, Angel::vec4 const &vec4,
 vec4 shade_ray_intersection(Scene const &scene,
                             std::shared_ptr<SceneObject> obj,
                             vec4 const &intersect_point, vec3 normal_sceneview,
-                            vec4 env_reflection, vec4 env_refraction);
+                            vec4 env_reflection, vec4 env_refraction,
+                            Sampler &sampler);
 
 Ray get_reflection_ray(vec3 const &intersection, vec3 const &incident,
                        vec3 const &normal);
 
 Ray get_refraction_ray(vec3 intersection, vec3 const &incident,
                        vec3 const &normal, float eta);
+
+/**
+ * @brief radiance along a camera ray by unidirectional path tracing.
+ * @detail Diffuse and glossy (modified phong) lobes are importance sampled
+ * and combined with explicit light sampling (next-event estimation) using
+ * the power heuristic. Mirror and refraction lobes are sampled as delta
+ * events. Whitted materials are rescaled to conserve energy; positional
+ * lights have intensity pi * diffuse_color so unit-distance diffuse
+ * shading matches the whitted integrator.
+ */
+vec4 trace_path(Scene const &scene, Ray ray, Sampler &sampler,
+                PathConfig const &cf, RayStats &stats);
 }
 
 #endif // RAYTRACER_RENDERER_H
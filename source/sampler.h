@@ -0,0 +1,143 @@
+/**
+ * @file ${FILE}
+ * @brief counter-based random streams for the ray tracer
+ * @license ${LICENSE}
+ *
+ **/
+#ifndef RAYTRACER_SAMPLER_H
+#define RAYTRACER_SAMPLER_H
+
+#include "types.h"
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace sls {
+
+/**
+ * @brief independent random streams. The stream id is part of the counter,
+ * so per-pixel and per-light draws never alias each other
+ */
+enum SampleStream : uint32_t {
+  StreamPixel = 0,
+  StreamLight = 1,
+};
+
+using philox_ctr_t = std::array<uint32_t, 4>;
+using philox_key_t = std::array<uint32_t, 2>;
+
+/**
+ * @brief Philox4x32-10 block function (Salmon et al., "Parallel random
+ * numbers: as easy as 1, 2, 3").
+ * @detail Stateless: the same (counter, key) always maps to the same four
+ * words, so any thread can evaluate any sample in any order.
+ */
+inline philox_ctr_t philox4x32(philox_ctr_t ctr, philox_key_t key) {
+  constexpr uint32_t m0 = 0xD2511F53;
+  constexpr uint32_t m1 = 0xCD9E8D57;
+  constexpr uint32_t w0 = 0x9E3779B9;
+  constexpr uint32_t w1 = 0xBB67AE85;
+
+  for (auto round = 0; round < 10; ++round) {
+    auto const p0 = uint64_t(m0) * ctr[0];
+    auto const p1 = uint64_t(m1) * ctr[2];
+
+    ctr = {uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], uint32_t(p1),
+           uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], uint32_t(p0)};
+
+    key[0] += w0;
+    key[1] += w1;
+  }
+  return ctr;
+}
+
+/**
+ * @brief maps the top 24 bits of a word to a float in [0, 1)
+ */
+inline float unit_float(uint32_t bits) {
+  return float(bits >> 8) * (1.0f / float(1u << 24));
+}
+
+/**
+ * @brief Per-(pixel, sample) random number source.
+ * @detail Each draw is keyed by (pixel, sample, dimension, stream) and the
+ * render seed; there is no shared engine state, so a Sampler can be
+ * constructed on whichever worker handles the pixel and the image is
+ * identical regardless of thread count or work scheduling.
+ */
+struct Sampler final {
+  uint64_t seed;
+  uint32_t pixel;
+  uint32_t sample;
+  uint32_t stream;
+  uint32_t dimension = 0;
+
+  Sampler(uint64_t seed, size_t pixel, size_t sample,
+          SampleStream stream = StreamPixel)
+      : seed(seed), pixel(uint32_t(pixel)), sample(uint32_t(sample)),
+        stream(stream) {}
+
+  /**
+   * @brief four uncorrelated words for the next dimension
+   */
+  philox_ctr_t next_block() {
+    return philox4x32({pixel, sample, dimension++, stream},
+                      {uint32_t(seed), uint32_t(seed >> 32)});
+  }
+
+  float next_1d() { return unit_float(next_block()[0]); }
+
+  vec2 next_2d() {
+    auto const bits = next_block();
+    return vec2(unit_float(bits[0]), unit_float(bits[1]));
+  }
+
+  /**
+   * @brief normally distributed value (Box-Muller) using one dimension
+   */
+  float next_normal(float mean, float std_dev) {
+    auto const u = next_2d();
+    auto const r = std::sqrt(-2.0f * std::log(1.0f - u.x));
+    return mean + std_dev * r * std::cos(float(2.0 * M_PI) * u.y);
+  }
+};
+
+//---------------------------------direction
+//sampling---------------------------------------
+
+/**
+ * @brief maps a direction in the frame (t, b, n) to world space, where t and
+ * b are any tangents perpendicular to the unit vector n
+ */
+inline vec3 from_local_frame(vec3 const &n, vec3 const &local) {
+  auto const axis =
+      std::fabs(n.x) > 0.9f ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+  auto const t = normalize(cross(axis, n));
+  auto const b = cross(n, t);
+  return local.x * t + local.y * b + local.z * n;
+}
+
+/**
+ * @brief cosine-weighted direction about +z; pdf is cos(theta) / pi
+ */
+inline vec3 sample_cosine_hemisphere(vec2 const &u) {
+  auto const r = std::sqrt(u.x);
+  auto const phi = float(2.0 * M_PI) * u.y;
+  return vec3(r * std::cos(phi), r * std::sin(phi),
+              std::sqrt(std::fmax(0.0f, 1.0f - u.x)));
+}
+
+/**
+ * @brief direction about +z distributed as cos^exponent; pdf is
+ * (exponent + 1) / (2 pi) * cos^exponent(theta)
+ */
+inline vec3 sample_phong_lobe(vec2 const &u, float exponent) {
+  auto const cos_theta = std::pow(u.x, 1.0f / (exponent + 1.0f));
+  auto const sin_theta =
+      std::sqrt(std::fmax(0.0f, 1.0f - cos_theta * cos_theta));
+  auto const phi = float(2.0 * M_PI) * u.y;
+  return vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+}
+}
+
+#endif // RAYTRACER_SAMPLER_H
@@ -16,64 +16,330 @@ mat4 const &SceneObject::modelview_inverse() const {
 
 void SceneObject::set_modelview(mat4 const &model_view) {
   this->modelview_ = model_view;
-  modelview_inverse_ = invert(model_view);
+  modelview_inverse_ = invert_transform(model_view);
   normalview_ = transpose(modelview_inverse_);
+  world_transform_ = AffineTransform(model_view);
+  object_transform_ = AffineTransform(modelview_inverse_);
 }
 
 mat4 const &SceneObject::normalview() const { return normalview_; }
 
+AffineTransform const &SceneObject::world_transform() const {
+  return world_transform_;
+}
+
+AffineTransform const &SceneObject::object_transform() const {
+  return object_transform_;
+}
+
 mat4 const &SceneObject::modelview() const { return modelview_; }
 
+CornellWalls cornell_wall_modelviews(double box_width, double box_depth,
+                                     double seam) {
+  auto const wall = 2.0 * (box_width + seam);
+  auto const z_mid = 0.5 * box_depth - box_width;
+
+  auto walls = CornellWalls();
+  walls.back = Translate(0.0, 0.0, -box_width) * Scale(wall, wall, 1.0);
+  walls.left = Translate(-box_width, 0.0, z_mid) * RotateY(90.0) *
+               Scale(box_depth, wall, 1.0);
+  walls.right = Translate(box_width, 0.0, z_mid) * RotateY(-90.0) *
+                Scale(box_depth, wall, 1.0);
+  walls.bottom = Translate(0.0, -box_width, z_mid) * RotateX(-90.0) *
+                 Scale(wall, box_depth, 1.0);
+  walls.top = Translate(0.0, box_width, z_mid) * RotateX(90.0) *
+              Scale(wall, box_depth, 1.0);
+  return walls;
+}
+
+//---------------------------------light
+//sampling---------------------------------------
+
+vec4 Scene::sample_light_location(size_t i, Sampler &sampler) const {
+  auto location = light_locations[i];
+  if (i >= light_shapes.size()) {
+    return location;
+  }
+
+  auto const &shape = light_shapes[i];
+  auto const u = sampler.next_2d();
+  auto offset = vec4(0.0, 0.0, 0.0, 0.0);
+
+  switch (shape.type) {
+  case LightSphere: { // uniform on the sphere surface
+    auto const z = 1.0f - 2.0f * u.x;
+    auto const r = std::sqrt(std::fmax(0.0f, 1.0f - z * z));
+    auto const phi = float(2.0 * M_PI) * u.y;
+    offset = shape.radius * vec4(r * std::cos(phi), r * std::sin(phi), z, 0.0);
+    break;
+  }
+  case LightQuad:
+    offset = (u.x - 0.5f) * shape.edge_u + (u.y - 0.5f) * shape.edge_v;
+    break;
+  case LightPoint:
+    break;
+  }
+
+  offset.w = 0.0;
+  return location + offset;
+}
+
+bool Scene::is_area_light(size_t i) const {
+  return i < light_shapes.size() && light_shapes[i].type != LightPoint &&
+         light_locations[i].w != 0.0;
+}
+
+float Scene::light_area(size_t i) const {
+  auto const &shape = light_shapes[i];
+  switch (shape.type) {
+  case LightSphere:
+    return float(4.0 * M_PI) * shape.radius * shape.radius;
+  case LightQuad:
+    return length(cross(shape.edge_u, shape.edge_v));
+  case LightPoint:
+  default:
+    return 0.0;
+  }
+}
+
+vec3 Scene::light_normal(size_t i, vec3 const &point) const {
+  auto const &shape = light_shapes[i];
+  if (shape.type == LightSphere) {
+    return normalize(point - xyz(light_locations[i]));
+  }
+  // quads emit on the side of edge_u x edge_v
+  return normalize(cross(shape.edge_u, shape.edge_v));
+}
+
+bool Scene::intersect_light(Ray const &ray, double max_t, size_t &light,
+                            double &t) const {
+  auto found = false;
+  auto const data = RayData(ray);
+  t = max_t;
+
+  for (auto i = 0lu; i < n_lights(); ++i) {
+    if (!is_area_light(i)) {
+      continue;
+    }
+
+    auto const &shape = light_shapes[i];
+    auto const &center = light_locations[i];
+    auto t_i = -1.0;
+
+    if (shape.type == LightSphere) {
+      t_i = ray_sphere_intersect(data, xyz(center), shape.radius);
+    } else {
+      auto const n = cross(shape.edge_u, shape.edge_v);
+      auto const denominator = dot(xyz(ray.dir), n);
+      if (std::fabs(denominator) < 1e-9) {
+        continue;
+      }
+
+      t_i = dot(xyz(center - ray.start), n) / denominator;
+      auto const local = xyz(ray.start + float(t_i) * ray.dir - center);
+      auto const a = dot(local, xyz(shape.edge_u)) /
+                     dot(xyz(shape.edge_u), xyz(shape.edge_u));
+      auto const b = dot(local, xyz(shape.edge_v)) /
+                     dot(xyz(shape.edge_v), xyz(shape.edge_v));
+      if (std::fabs(a) > 0.5 || std::fabs(b) > 0.5) {
+        continue;
+      }
+    }
+
+    if (t_i > 1e-6 && t_i < t) {
+      t = t_i;
+      light = i;
+      found = true;
+    }
+  }
+  return found;
+}
+
 //---------------------------------sphere
 //intersections---------------------------------------
 
 double UnitSphere::intersect_t(Ray const &ray) const {
+  return intersect_t(RayData(ray));
+}
+
+double UnitSphere::intersect_t(RayData const &ray) const {
   using namespace Angel;
-  auto const &mv = modelview();
-  auto world_origin = mv * vec4(0.0, 0.0, 0.0, 1.0);
-  auto world_radius = length(mv * vec4(0.0, 0.0, radius, 0.0));
-  auto t =
-      raySphereIntersection(ray.start, ray.dir, world_origin, world_radius);
-  return t;
+  auto const &world = world_transform();
+  auto world_radius = length(transform_vector(world, vec3(0.0, 0.0, radius)));
+  return ray_sphere_intersect(ray, world.translation, world_radius);
 }
 
 Intersection UnitSphere::intersect(Ray const &ray) const {
   auto t = intersect_t(ray);
-  auto hitpoint = ray.start + t * ray.dir;
-  return Intersection(
-      t, normalize(xyz(normalview() * (modelview_inverse() * hitpoint))));
+  auto hitpoint = xyz(ray.start + t * ray.dir);
+  auto const &object = object_transform();
+  return Intersection(t, normalize(transform_normal(
+                             object, transform_point(object, hitpoint))));
 }
 
 bool UnitSphere::on_surface(vec3 const &point) const {
-  auto origin = xyz(modelview() * vec4(0.0, 0.0, 0.0, 1.0));
-  auto from_origin = point - origin;
+  auto from_origin = point - world_transform().translation;
 
   return nearlyEqual(length(from_origin), radius, 1e-7);
 }
 
 bool UnitSphere::inside(vec3 const &point) const {
 
-  auto origin = xyz(modelview() * vec4(0.0, 0.0, 0.0, 1.0));
-  auto from_origin = point - origin;
+  auto from_origin = point - world_transform().translation;
 
   return length(from_origin) < radius;
 }
 
 vec3 UnitSphere::surface_normal(vec3 const &point) const {
-  auto p_object_view = modelview_inverse() * vec4(point, 1.0);
-
-  return Angel::normalize(xyz(p_object_view));
+  return Angel::normalize(transform_point(object_transform(), point));
 }
 
 //---------------------------------plane
 //intersections---------------------------------------
-Intersection Plane::intersect(Ray const &ray) const {
+void Plane::set_modelview(mat4 const &model_view) {
+  SceneObject::set_modelview(model_view);
+  update_plane();
+}
+
+void Plane::update_plane() {
+  auto const &object = object_transform();
+  auto const normal = normalize(transform_normal(object, vec3(0.0, 0.0, 1.0)));
+  auto const point = world_transform().translation;
+  equation = vec4(normal, -dot(normal, point));
+  local_x = vec4(object.linear[0], object.translation.x);
+  local_y = vec4(object.linear[1], object.translation.y);
+}
+
+double Plane::intersect_t(Ray const &ray) const {
   using namespace Angel;
-  auto mvi = modelview_inverse();
-  auto ray_local = Ray(mvi * ray.start, mvi * ray.dir);
+  auto const denominator = dot(equation, ray.dir);
+  if (std::fabs(denominator) < 1e-9) { // parallel to the plane
+    return -1.0;
+  }
+
+  auto const t = -dot(equation, ray.start) / denominator;
+  return t > 0.0 ? t : -1.0;
+}
+
+Intersection Plane::intersect(Ray const &ray) const {
+  return Intersection(intersect_t(ray), xyz(equation));
+}
+
+float Plane::distance(vec3 const &point) const {
+  return dot(equation, vec4(point, 1.0));
+}
+
+bool Plane::on_surface(vec3 const &point) const {
+  return std::fabs(distance(point)) < 1e-6;
+}
+
+bool Plane::inside(vec3 const &point) const { return distance(point) < 0.0; }
+
+vec3 Plane::surface_normal(vec3 const &point) const { return xyz(equation); }
+
+//---------------------------------bounded plane
+//intersections---------------------------------------
+bool Quad::covers(vec4 const &point) const {
+  return std::fabs(dot(local_x, point)) <= 0.5f &&
+         std::fabs(dot(local_y, point)) <= 0.5f;
+}
+
+double Quad::intersect_t(Ray const &ray) const {
+  auto const t = Plane::intersect_t(ray);
+  if (t < 0.0 || !covers(ray.start + float(t) * ray.dir)) {
+    return -1.0;
+  }
+  return t;
+}
+
+bool Quad::on_surface(vec3 const &point) const {
+  return Plane::on_surface(point) && covers(vec4(point, 1.0));
+}
+
+bool Disk::covers(vec4 const &point) const {
+  auto const x = dot(local_x, point);
+  auto const y = dot(local_y, point);
+  return x * x + y * y <= 1.0f;
+}
+
+double Disk::intersect_t(Ray const &ray) const {
+  auto const t = Plane::intersect_t(ray);
+  if (t < 0.0 || !covers(ray.start + float(t) * ray.dir)) {
+    return -1.0;
+  }
+  return t;
+}
+
+bool Disk::on_surface(vec3 const &point) const {
+  return Plane::on_surface(point) && covers(vec4(point, 1.0));
+}
+
+//---------------------------------box
+//intersections---------------------------------------
+void AxisBox::set_modelview(mat4 const &model_view) {
+  SceneObject::set_modelview(model_view);
+  update_bounds();
+}
+
+void AxisBox::update_bounds() {
+  auto const &mv = modelview();
+  auto const center = xyz(mv * vec4(0.0, 0.0, 0.0, 1.0));
+  // half extent along each world axis of the transformed [-1, 1] cube
+  auto const extent = vec3(
+      std::fabs(mv[0][0]) + std::fabs(mv[0][1]) + std::fabs(mv[0][2]),
+      std::fabs(mv[1][0]) + std::fabs(mv[1][1]) + std::fabs(mv[1][2]),
+      std::fabs(mv[2][0]) + std::fabs(mv[2][1]) + std::fabs(mv[2][2]));
+  lo = center - extent;
+  hi = center + extent;
+}
+
+double AxisBox::intersect_t(Ray const &ray) const {
+  return intersect_t(RayData(ray));
+}
+
+double AxisBox::intersect_t(RayData const &ray) const {
+  return ray_box_intersect(ray, lo, hi);
+}
+
+Intersection AxisBox::intersect(Ray const &ray) const {
+  auto const t = intersect_t(ray);
+  auto const hitpoint = xyz(ray.start + float(t) * ray.dir);
+  return Intersection(t, surface_normal(hitpoint));
+}
+
+bool AxisBox::on_surface(vec3 const &point) const {
+  auto const eps = 1e-6f;
+  auto const in_slabs = [&](int i) {
+    return point[i] >= lo[i] - eps && point[i] <= hi[i] + eps;
+  };
+  auto const on_face = [&](int i) {
+    return std::fabs(point[i] - lo[i]) < eps ||
+           std::fabs(point[i] - hi[i]) < eps;
+  };
+  return in_slabs(0) && in_slabs(1) && in_slabs(2) &&
+         (on_face(0) || on_face(1) || on_face(2));
+}
+
+bool AxisBox::inside(vec3 const &point) const {
+  return point.x > lo.x && point.x < hi.x && point.y > lo.y &&
+         point.y < hi.y && point.z > lo.z && point.z < hi.z;
+}
 
-  auto t = ray_plane_intersect(ray_local);
+vec3 AxisBox::surface_normal(vec3 const &point) const {
+  // the axis where point is furthest out, relative to the box's size
+  auto const from_center = point - 0.5f * (lo + hi);
+  auto const size = hi - lo;
+  auto const local = vec3(from_center.x / size.x, from_center.y / size.y,
+                          from_center.z / size.z);
+  auto axis = 0;
+  for (auto i = 1; i < 3; ++i) {
+    if (std::fabs(local[i]) > std::fabs(local[axis])) {
+      axis = i;
+    }
+  }
 
-  return Intersection(t, xyz(normalview() * vec4(0.0, 0.0, 1.0, 0.0)));
+  auto normal = vec3(0.0, 0.0, 0.0);
+  normal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+  return normal;
 }
 }
\ No newline at end of file
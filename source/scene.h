@@ -14,6 +14,7 @@
 #include "common-math.h"
 #include "common/Angel.h"
 #include "common/ObjMesh.h"
+#include "sampler.h"
 #include "types.h"
 #include <memory>
 #include <vector>
@@ -160,21 +161,44 @@ public:
    */
   virtual double intersect_t(Ray const &ray) const { return intersect(ray).t; }
 
+  /**
+   * @brief intersection distance for a ray prepared once and tested against
+   * many objects
+   */
+  virtual double intersect_t(RayData const &ray) const {
+    return intersect_t(ray.ray);
+  }
+
   //---------------------------------matrix
   //accessors---------------------------------------
 
   mat4 const &modelview() const;
 
-  void set_modelview(mat4 const &model_view);
+  /**
+   * @detail derived objects that cache world-space data refresh it here
+   */
+  virtual void set_modelview(mat4 const &model_view);
 
   mat4 const &modelview_inverse() const;
 
   mat4 const &normalview() const;
 
+  /**
+   * @brief modelview and its inverse without the ( 0, 0, 0, 1 ) bottom row,
+   * for the per-ray paths
+   * @detail the modelview is taken to be affine, as everything built from
+   * Translate, Scale and Rotate* is
+   */
+  Angel::AffineTransform const &world_transform() const;
+
+  Angel::AffineTransform const &object_transform() const;
+
 private:
   Angel::mat4 modelview_;
   Angel::mat4 modelview_inverse_;
   Angel::mat4 normalview_;
+  Angel::AffineTransform world_transform_;
+  Angel::AffineTransform object_transform_;
 };
 
 struct LightColor {
@@ -183,12 +207,44 @@ struct LightColor {
   Angel::vec4 specular_color = vec4(1.0, 1.0, 1.0, 1.0);
 };
 
+enum LightShapeType { LightPoint = 0, LightSphere, LightQuad };
+
+/**
+ * @brief emitting surface around a light location.
+ * @detail sphere lights use radius; quad lights span
+ * location +/- (edge_u + edge_v) / 2. For directional lights (w == 0) the
+ * offset perturbs the direction instead, giving a soft sun.
+ */
+struct LightShape {
+  LightShapeType type = LightPoint;
+  float radius = 0.0;
+  Angel::vec4 edge_u = vec4(0.0, 0.0, 0.0, 0.0);
+  Angel::vec4 edge_v = vec4(0.0, 0.0, 0.0, 0.0);
+
+  static LightShape sphere(float radius) {
+    auto self = LightShape();
+    self.type = LightSphere;
+    self.radius = radius;
+    return self;
+  }
+
+  static LightShape quad(vec4 const &edge_u, vec4 const &edge_v) {
+    auto self = LightShape();
+    self.type = LightQuad;
+    self.edge_u = edge_u;
+    self.edge_v = edge_v;
+    return self;
+  }
+};
+
 struct Scene {
 
   Angel::mat4 camera_modelview;
 
   std::vector<LightColor> light_colors;
   std::vector<Angel::vec4> light_locations;
+  // optional; lights without an entry are treated as points
+  std::vector<LightShape> light_shapes;
 
   std::vector<std::shared_ptr<SceneObject>> objects;
 
@@ -197,6 +253,33 @@ struct Scene {
   size_t n_lights() const {
     return std::min(light_colors.size(), light_locations.size());
   }
+
+  /**
+   * @brief draws a point on the surface of light i (world space).
+   * @detail The scene itself is never modified, so any number of shading
+   * points and samples can draw concurrently.
+   */
+  vec4 sample_light_location(size_t i, Sampler &sampler) const;
+
+  /**
+   * @brief true for positional lights with an emitting surface
+   */
+  bool is_area_light(size_t i) const;
+
+  float light_area(size_t i) const;
+
+  /**
+   * @brief outward normal of area light i at a point on its surface
+   */
+  vec3 light_normal(size_t i, vec3 const &point) const;
+
+  /**
+   * @brief nearest area light hit by ray closer than max_t
+   * @param light index of the light hit
+   * @param t distance along ray
+   */
+  bool intersect_light(Ray const &ray, double max_t, size_t &light,
+                       double &t) const;
 };
 
 struct UnitSphere : public SceneObject {
@@ -220,6 +303,8 @@ struct UnitSphere : public SceneObject {
 
   virtual double intersect_t(Ray const &ray) const override;
 
+  virtual double intersect_t(RayData const &ray) const override;
+
   Intersection intersect(Ray const &ray) const override;
 
   virtual bool on_surface(vec3 const &point) const override;
@@ -231,14 +316,154 @@ struct UnitSphere : public SceneObject {
 
 /**
  * @brief Describes an infinite area plane
+ * @detail In object space the plane is z = 0 with normal +z. The world-space
+ * plane equation is kept up to date by set_modelview, so intersection is a
+ * dot product against the ray start and one against its direction.
  */
 struct Plane : public SceneObject {
 
   Plane(Material const &mtl, Angel::mat4 modelview = Angel::mat4(),
         std::shared_ptr<GLMesh> mesh = nullptr)
-      : SceneObject(mtl, modelview, mesh) {}
+      : SceneObject(mtl, modelview, mesh) {
+    // the base constructor can't reach the override
+    update_plane();
+  }
+
+  virtual void set_modelview(mat4 const &model_view) override;
+
+  using SceneObject::intersect_t;
+
+  virtual double intersect_t(Ray const &ray) const override;
 
   Intersection intersect(Ray const &ray) const override;
+
+  virtual bool on_surface(vec3 const &point) const override;
+
+  /**
+   * @brief points behind the plane (against its normal) are inside
+   */
+  virtual bool inside(vec3 const &point) const override;
+
+  virtual vec3 surface_normal(vec3 const &point) const override;
+
+  /**
+   * @brief signed distance of point from the plane along its normal
+   */
+  float distance(vec3 const &point) const;
+
+protected:
+  // rows of the inverse modelview: dotted with a homogeneous world point they
+  // give its object-space x and y, which bounded patches test against
+  vec4 local_x = vec4(1.0, 0.0, 0.0, 0.0);
+  vec4 local_y = vec4(0.0, 1.0, 0.0, 0.0);
+
+private:
+  void update_plane();
+
+  // unit world-space normal and -dot(normal, p) for p on the plane, so
+  // dot(equation, point) is the signed distance of a homogeneous point
+  vec4 equation = vec4(0.0, 0.0, 1.0, 0.0);
 };
+
+/**
+ * @brief the square |x|, |y| <= 0.5 of the object-space plane; scale the
+ * modelview to size it
+ */
+struct Quad : public Plane {
+
+  Quad(Material const &mtl, Angel::mat4 modelview = Angel::mat4(),
+       std::shared_ptr<GLMesh> mesh = nullptr)
+      : Plane(mtl, modelview, mesh) {}
+
+  using Plane::intersect_t;
+
+  virtual double intersect_t(Ray const &ray) const override;
+
+  virtual bool on_surface(vec3 const &point) const override;
+
+private:
+  bool covers(vec4 const &point) const;
+};
+
+/**
+ * @brief the unit disk x^2 + y^2 <= 1 of the object-space plane
+ */
+struct Disk : public Plane {
+
+  Disk(Material const &mtl, Angel::mat4 modelview = Angel::mat4(),
+       std::shared_ptr<GLMesh> mesh = nullptr)
+      : Plane(mtl, modelview, mesh) {}
+
+  using Plane::intersect_t;
+
+  virtual double intersect_t(Ray const &ray) const override;
+
+  virtual bool on_surface(vec3 const &point) const override;
+
+private:
+  bool covers(vec4 const &point) const;
+};
+
+/**
+ * @brief a box, -1 to 1 on each axis in object space, kept axis-aligned in
+ * world space
+ * @detail set_modelview stores the world bounds of the transformed cube, so
+ * intersection is a slab test with no matrix work. Under a rotation the box
+ * grows to the bounds of the rotated cube rather than turning with it.
+ */
+struct AxisBox : public SceneObject {
+
+  AxisBox(Material const &mtl, Angel::mat4 modelview = Angel::mat4(),
+          std::shared_ptr<GLMesh> mesh = nullptr)
+      : SceneObject(mtl, modelview, mesh) {
+    update_bounds();
+  }
+
+  virtual void set_modelview(mat4 const &model_view) override;
+
+  virtual double intersect_t(Ray const &ray) const override;
+
+  virtual double intersect_t(RayData const &ray) const override;
+
+  Intersection intersect(Ray const &ray) const override;
+
+  virtual bool on_surface(vec3 const &point) const override;
+
+  virtual bool inside(vec3 const &point) const override;
+
+  /**
+   * @brief outward normal of the face nearest to point
+   */
+  virtual vec3 surface_normal(vec3 const &point) const override;
+
+  vec3 const &lower() const { return lo; }
+  vec3 const &upper() const { return hi; }
+
+private:
+  void update_bounds();
+
+  vec3 lo = vec3(-1.0, -1.0, -1.0);
+  vec3 hi = vec3(1.0, 1.0, 1.0);
+};
+
+/**
+ * @brief modelviews of the Cornell box walls, each a unit Quad facing into
+ * the box
+ */
+struct CornellWalls {
+  mat4 back;
+  mat4 left;
+  mat4 right;
+  mat4 bottom;
+  mat4 top;
+};
+
+/**
+ * @brief walls at +-box_width on x and y and a back wall at z = -box_width;
+ * the open front is box_depth from the back. Every wall reaches seam past
+ * the walls it meets so no ray slips through a corner.
+ */
+CornellWalls cornell_wall_modelviews(double box_width, double box_depth,
+                                     double seam);
 }
 #endif // RAYTRACER_SCENE_H
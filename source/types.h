@@ -86,7 +86,7 @@ public:
   //---------------------------------material
   //prefabs---------------------------------------
 
-  static Material glass() {
+  static constexpr Material glass() {
     auto self = Material();
 
     self.k_specular = 0.01;
@@ -98,7 +98,7 @@ public:
     return self;
   }
 
-  static Material bottle_glass() {
+  static constexpr Material bottle_glass() {
     auto self = glass();
     self.k_transmittance = 0.8;
     self.color = vec4(0.2, 0.9, 0.9, 1.0);
@@ -110,7 +110,7 @@ public:
     return self;
   }
 
-  static Material wall_a() {
+  static constexpr Material wall_a() {
     auto self = Material();
 
     self.color = vec4(1.0, 0.0, 0.0, 1.0);
@@ -125,7 +125,7 @@ public:
     return self;
   }
 
-  static Material wall_b() {
+  static constexpr Material wall_b() {
     auto self = wall_a();
 
     self.color = vec4(0.0, 1.0, 1.0, 1.0);
@@ -134,7 +134,7 @@ public:
     return self;
   }
 
-  static Material wall_white() {
+  static constexpr Material wall_white() {
     auto self = Material();
 
     self.specular = 0.1;
@@ -142,7 +142,7 @@ public:
     return self;
   }
 
-  static Material floor() {
+  static constexpr Material floor() {
     auto self = Material();
 
     self.k_specular = 0.2;
@@ -151,7 +151,7 @@ public:
     return self;
   }
 
-  static Material gold() {
+  static constexpr Material gold() {
     auto self = Material();
 
     self.color = vec4(1.0, 1.0, 0.0, 1.0);
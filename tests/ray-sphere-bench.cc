@@ -0,0 +1,84 @@
+/**
+ * @file ${FILE}
+ * @brief ray_sphere_intersect against raySphereIntersection, which it replaced
+ * @license ${LICENSE}
+ *
+ **/
+#include "common-math.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace sls;
+
+namespace {
+
+/**
+ * @brief the kernel it replaced, raySphereIntersection: the full quadratic
+ * with c from a float length, and the smaller root even when it is behind
+ * the origin
+ */
+double previous_t(vec4 const &p0, vec4 const &dir, vec4 const &center,
+                  double radius) {
+  auto const f = p0 - center;
+  auto const b = double(dot(2.0f * dir, f));
+  auto const c = double(length(f) * length(f)) - radius * radius;
+  auto const discriminant = b * b - 4.0 * c;
+  if (discriminant < 0.0) {
+    return -1.0;
+  }
+  auto const root = std::sqrt(discriminant);
+  return std::min(-b + root, -b - root) / 2.0;
+}
+
+template <typename FN_T>
+double time_ns_per_test(size_t n_tests, FN_T fn) {
+  auto const start = std::chrono::steady_clock::now();
+  fn();
+  auto const ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return ns / n_tests;
+}
+}
+
+int main() {
+  auto const n_rays = size_t(1) << 20;
+  auto const r = 1e2;
+  vec3 const centers[] = {vec3(0.0, 0.0, -r - 1.0), vec3(-r - 1.0, 0.0, 0.0),
+                          vec3(r + 1.0, 0.0, 0.0), vec3(0.0, -r - 1.0, 0.0),
+                          vec3(0.0, r + 1.0, 0.0)};
+  auto const n_tests = n_rays * 5;
+
+  auto rng = std::mt19937(1);
+  auto u = std::uniform_real_distribution<float>(-0.95f, 0.95f);
+  auto rays = std::vector<Ray>();
+  for (auto i = 0lu; i < n_rays; ++i) {
+    rays.push_back(Ray(vec4(u(rng), u(rng), u(rng), 1.0),
+                       vec4(normalize(vec3(u(rng), u(rng), u(rng))), 0.0)));
+  }
+
+  auto sum = 0.0;
+  auto const textbook_ns = time_ns_per_test(n_tests, [&]() {
+    for (auto const &ray : rays) {
+      for (auto const &center : centers) {
+        sum += previous_t(ray.start, ray.dir, vec4(center, 1.0), r);
+      }
+    }
+  });
+
+  // the ray data is built once per ray, as the renderer does
+  auto const kernel_ns = time_ns_per_test(n_tests, [&]() {
+    for (auto const &ray : rays) {
+      auto const data = RayData(ray);
+      for (auto const &center : centers) {
+        sum += ray_sphere_intersect(data, center, r);
+      }
+    }
+  });
+
+  std::cout << "raySphereIntersection (previous): " << textbook_ns << " ns/test\n"
+            << "ray_sphere_intersect: " << kernel_ns << " ns/test\n"
+            << "(checksum " << sum << ")\n";
+  return 0;
+}
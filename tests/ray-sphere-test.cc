@@ -0,0 +1,127 @@
+/**
+ * @file ${FILE}
+ * @brief ray_sphere_intersect against a long double reference
+ * @license ${LICENSE}
+ *
+ **/
+#include "common-math.h"
+#include "test-utils.h"
+#include <random>
+
+using namespace sls;
+
+namespace {
+
+/**
+ * @brief nearest positive root, solved in long double along the
+ * normalized direction with the textbook quadratic
+ */
+long double reference_t(vec3 const &origin, vec3 const &dir,
+                        vec3 const &center, long double radius) {
+  auto const len = std::sqrt((long double)dir.x * dir.x +
+                             (long double)dir.y * dir.y +
+                             (long double)dir.z * dir.z);
+  long double const d[] = {dir.x / len, dir.y / len, dir.z / len};
+  long double const f[] = {(long double)origin.x - center.x,
+                           (long double)origin.y - center.y,
+                           (long double)origin.z - center.z};
+
+  auto const b = f[0] * d[0] + f[1] * d[1] + f[2] * d[2];
+  auto const c = f[0] * f[0] + f[1] * f[1] + f[2] * f[2] - radius * radius;
+  auto const discriminant = b * b - c;
+  if (discriminant < 0) {
+    return -1;
+  }
+
+  auto const root = std::sqrt(discriminant);
+  auto const t = -b - root > 0 ? -b - root : -b + root;
+  return t > 0 ? t / len : -1;
+}
+
+double kernel_t(vec3 const &origin, vec3 const &dir, vec3 const &center,
+                double radius) {
+  return ray_sphere_intersect(RayData(Ray(vec4(origin, 1.0), vec4(dir, 0.0))),
+                              center, radius);
+}
+
+/**
+ * @brief rays from inside the Cornell box against the five 1e2-radius wall
+ * spheres it used to be built from
+ */
+void wall_spheres() {
+  auto const r = 1e2;
+  vec3 const centers[] = {vec3(0.0, 0.0, -r - 1.0), vec3(-r - 1.0, 0.0, 0.0),
+                          vec3(r + 1.0, 0.0, 0.0), vec3(0.0, -r - 1.0, 0.0),
+                          vec3(0.0, r + 1.0, 0.0)};
+
+  auto rng = std::mt19937(7);
+  auto u = std::uniform_real_distribution<float>(-0.95f, 0.95f);
+  auto max_error = 0.0;
+  auto n_hits = 0;
+  for (auto i = 0; i < 100000; ++i) {
+    auto const origin = vec3(u(rng), u(rng), u(rng));
+    auto const dir = vec3(u(rng), u(rng), u(rng));
+    for (auto const &center : centers) {
+      auto const expected = reference_t(origin, dir, center, r);
+      auto const actual = kernel_t(origin, dir, center, r);
+      if (!SLS_CHECK((expected < 0) == (actual < 0)) || expected < 0) {
+        continue;
+      }
+      ++n_hits;
+      max_error = std::max(
+          max_error, double(std::fabs(actual - expected) / expected));
+    }
+  }
+
+  std::cout << n_hits << " wall hits, max relative error " << max_error
+            << "\n";
+  // measured 1.1e-5, bounded by the float inputs; raySphereIntersection,
+  // which this replaced, was off by 1.4e-3 on the same rays
+  SLS_CHECK(n_hits > 0);
+  SLS_CHECK(max_error < 2e-5);
+}
+
+void inside_returns_exit() {
+  // unit sphere at the origin; a direction of length 2 halves the ray's t
+  SLS_CHECK_NEAR(kernel_t(vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, 2.0),
+                          vec3(0.0, 0.0, 0.0), 1.0),
+                 0.5, 1e-7);
+  SLS_CHECK_NEAR(kernel_t(vec3(0.5, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+                          vec3(0.0, 0.0, 0.0), 1.0),
+                 1.5, 1e-7);
+}
+
+void tangent() {
+  SLS_CHECK_NEAR(kernel_t(vec3(0.0, 1.0, -5.0), vec3(0.0, 0.0, 1.0),
+                          vec3(0.0, 0.0, 0.0), 1.0),
+                 5.0, 1e-6);
+  SLS_CHECK(kernel_t(vec3(0.0, 1.001f, -5.0), vec3(0.0, 0.0, 1.0),
+                     vec3(0.0, 0.0, 0.0), 1.0) < 0.0);
+}
+
+void behind_origin() {
+  SLS_CHECK(kernel_t(vec3(0.0, 0.0, 5.0), vec3(0.0, 0.0, 1.0),
+                     vec3(0.0, 0.0, 0.0), 1.0) < 0.0);
+  SLS_CHECK(kernel_t(vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, -1.0),
+                     vec3(0.0, 0.0, 3.0), 1.0) < 0.0);
+}
+
+void range() {
+  auto const ray = RayData(Ray(vec4(0.0, 0.0, 0.0, 1.0),
+                               vec4(0.0, 0.0, -1.0, 0.0)));
+  auto const center = vec3(0.0, 0.0, -5.0);
+  SLS_CHECK_NEAR(ray_sphere_intersect(ray, center, 1.0), 4.0, 1e-6);
+  // past the near root the far one is next
+  SLS_CHECK_NEAR(ray_sphere_intersect(ray, center, 1.0, 4.5), 6.0, 1e-6);
+  SLS_CHECK(ray_sphere_intersect(ray, center, 1.0, 0.0, 3.0) < 0.0);
+}
+}
+
+int main() {
+  wall_spheres();
+  inside_returns_exit();
+  tangent();
+  behind_origin();
+  range();
+  return sls::test::result("ray-sphere-test");
+}
@@ -0,0 +1,60 @@
+/**
+ * @file ${FILE}
+ * @brief minimal checks for the test executables
+ * @license ${LICENSE}
+ *
+ **/
+#ifndef RAYTRACER_TEST_UTILS_H
+#define RAYTRACER_TEST_UTILS_H
+
+#include <cmath>
+#include <iostream>
+
+namespace sls {
+namespace test {
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+inline bool check(bool ok, const char *expr, const char *file, int line) {
+  if (!ok) {
+    std::cerr << file << ":" << line << ": check failed: " << expr << "\n";
+    ++failures();
+  }
+  return ok;
+}
+
+inline bool check_near(double actual, double expected, double tolerance,
+                       const char *expr, const char *file, int line) {
+  auto const ok = std::fabs(actual - expected) <= tolerance;
+  if (!ok) {
+    std::cerr << file << ":" << line << ": " << expr << " is " << actual
+              << ", expected " << expected << " +/- " << tolerance << "\n";
+    ++failures();
+  }
+  return ok;
+}
+
+/**
+ * @return the process exit code: 0 if every check passed
+ */
+inline int result(const char *name) {
+  if (failures() > 0) {
+    std::cerr << name << ": " << failures() << " checks failed\n";
+    return 1;
+  }
+  std::cout << name << ": ok\n";
+  return 0;
+}
+}
+}
+
+#define SLS_CHECK(expr) ::sls::test::check((expr), #expr, __FILE__, __LINE__)
+
+#define SLS_CHECK_NEAR(actual, expected, tolerance)                            \
+  ::sls::test::check_near((actual), (expected), (tolerance), #actual,          \
+                          __FILE__, __LINE__)
+
+#endif // RAYTRACER_TEST_UTILS_H